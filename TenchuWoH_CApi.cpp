@@ -0,0 +1,180 @@
+// Implementação da API C (TenchuWoH_CApi.h) sobre o núcleo. Toda exceção
+// do núcleo vira um código de status aqui: nada atravessa a fronteira C.
+
+#include "TenchuWoH_CApi.h"
+#include "TenchuWoH_Internal.h"
+
+#include <cerrno>
+#include <new>
+#include <stdexcept>
+
+struct twoh_container {
+    MappedFile file; // Só em twoh_open_file(_w)
+    ByteView data;
+    std::vector<ScanResult> blocks;
+};
+
+namespace {
+
+thread_local int t_lastOsError = 0; // twoh_last_os_error()
+
+// Mesmo scan do scanContainer(), sem log nem progresso: quem chama é outro
+// programa, não o console.
+void scanInto(twoh_container& c) {
+    if (c.data.size() < 12) return;
+    std::vector<ScanResult> candidates;
+    uint64_t count = 0;
+    scanRange(c.data, 0, c.data.size(), candidates, count);
+    c.blocks = dedupScanResults(candidates);
+}
+
+// Descomprime um bloco cujo tamanho de saída já é conhecido.
+int decodeChecked(ByteView block, size_t decompressedSize, void* dst, size_t capacity, size_t* written) {
+    if (written) *written = decompressedSize;
+    if (capacity < decompressedSize) return TWOH_ERR_BUFFER_TOO_SMALL;
+    if (!dst && decompressedSize > 0) return TWOH_ERR_ARGUMENT;
+    size_t got = decompressLZSSBlockInto(block, static_cast<uint8_t*>(dst), capacity);
+    if (written) *written = got;
+    return got == decompressedSize ? TWOH_OK : TWOH_ERR_CORRUPT;
+}
+
+template <class F>
+int guarded(F&& f) {
+    try {
+        return f();
+    }
+    catch (const std::bad_alloc&) {
+        return TWOH_ERR_OUT_OF_MEMORY;
+    }
+    catch (const std::length_error&) {
+        return TWOH_ERR_BUFFER_TOO_SMALL;
+    }
+    catch (...) {
+        return TWOH_ERR_CORRUPT;
+    }
+}
+
+// twoh_open_file / twoh_open_file_w.
+int openFile(const std::filesystem::path& path, twoh_container** out) {
+    *out = nullptr;
+    return guarded([&] {
+        std::unique_ptr<twoh_container> c(new twoh_container);
+        if (!c->file.open(path)) {
+            // Lido logo após a falha, antes que o close() no destrutor o mude.
+#ifdef _WIN32
+            t_lastOsError = (int)GetLastError();
+#else
+            t_lastOsError = errno;
+#endif
+            return (int)TWOH_ERR_IO;
+        }
+        c->data = c->file.view();
+        scanInto(*c);
+        *out = c.release();
+        return (int)TWOH_OK;
+    });
+}
+
+} // namespace
+
+extern "C" {
+
+uint32_t twoh_api_version(void) {
+    return TWOH_API_VERSION;
+}
+
+const char* twoh_status_string(int status) {
+    switch (status) {
+    case TWOH_OK: return "ok";
+    case TWOH_ERR_ARGUMENT: return "argumento invalido";
+    case TWOH_ERR_IO: return "erro de leitura do arquivo";
+    case TWOH_ERR_CORRUPT: return "bloco LZSS invalido";
+    case TWOH_ERR_BUFFER_TOO_SMALL: return "buffer de saida pequeno demais";
+    case TWOH_ERR_OUT_OF_MEMORY: return "memoria insuficiente";
+    default: return "status desconhecido";
+    }
+}
+
+int twoh_open_memory(const void* data, size_t size, twoh_container** out) {
+    if (!out || (!data && size > 0)) return TWOH_ERR_ARGUMENT;
+    *out = nullptr;
+    return guarded([&] {
+        std::unique_ptr<twoh_container> c(new twoh_container);
+        c->data = ByteView(static_cast<const uint8_t*>(data), size);
+        scanInto(*c);
+        *out = c.release();
+        return (int)TWOH_OK;
+    });
+}
+
+int twoh_open_file(const char* path, twoh_container** out) {
+    if (!out || !path) return TWOH_ERR_ARGUMENT;
+    return openFile(path, out);
+}
+
+#if defined(_WIN32)
+int twoh_open_file_w(const wchar_t* path, twoh_container** out) {
+    if (!out || !path) return TWOH_ERR_ARGUMENT;
+    return openFile(std::filesystem::path(path), out);
+}
+#endif
+
+int twoh_last_os_error(void) {
+    return t_lastOsError;
+}
+
+void twoh_close(twoh_container* container) {
+    delete container;
+}
+
+size_t twoh_block_count(const twoh_container* container) {
+    return container ? container->blocks.size() : 0;
+}
+
+int twoh_block_info_at(const twoh_container* container, size_t index, twoh_block_info* info) {
+    if (!container || !info || index >= container->blocks.size()) return TWOH_ERR_ARGUMENT;
+    const ScanResult& r = container->blocks[index];
+    info->offset = r.offset;
+    info->compressed_size = r.consumedSize;
+    info->decompressed_size = r.decompressedSize;
+    return TWOH_OK;
+}
+
+int twoh_block_data(const twoh_container* container, size_t index, const void** data, size_t* size) {
+    if (!container || !data || !size || index >= container->blocks.size()) return TWOH_ERR_ARGUMENT;
+    const ScanResult& r = container->blocks[index];
+    *data = container->data.data() + r.offset;
+    *size = r.consumedSize;
+    return TWOH_OK;
+}
+
+int twoh_decode_block(const twoh_container* container, size_t index, void* dst, size_t capacity, size_t* written) {
+    if (!container || index >= container->blocks.size()) return TWOH_ERR_ARGUMENT;
+    const ScanResult& r = container->blocks[index];
+    return guarded([&] {
+        return decodeChecked(ByteView(container->data.data() + r.offset, r.consumedSize), r.decompressedSize,
+            dst, capacity, written);
+    });
+}
+
+int twoh_probe_block(const void* data, size_t size, twoh_block_info* info) {
+    if (!data || !info) return TWOH_ERR_ARGUMENT;
+    DecompressValidationResult res = validateLZSSBlock(static_cast<const uint8_t*>(data), size, size);
+    if (!res.success) return TWOH_ERR_CORRUPT;
+    info->offset = 0;
+    info->compressed_size = res.consumedBytes;
+    info->decompressed_size = res.decompressedSize;
+    return TWOH_OK;
+}
+
+int twoh_decode(const void* block, size_t size, void* dst, size_t capacity, size_t* written) {
+    twoh_block_info info;
+    int status = twoh_probe_block(block, size, &info);
+    if (status != TWOH_OK) return status;
+    return guarded([&] {
+        return decodeChecked(ByteView(static_cast<const uint8_t*>(block), (size_t)info.compressed_size),
+            (size_t)info.decompressed_size, dst, capacity, written);
+    });
+}
+
+} // extern "C"
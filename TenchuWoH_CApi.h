@@ -0,0 +1,127 @@
+/*
+ * API C do TenchuWoH_DeCompressor: abre um container (da memória ou do
+ * disco), lista os blocos LZSS achados pelo scanner e descomprime cada um
+ * num buffer do chamador. Serve para pipelines de assets chamarem o
+ * scanner/descompressor no próprio processo, sem arquivos temporários.
+ *
+ * Depois de aberto, um container não muda: as funções de consulta e de
+ * descompressão podem ser chamadas de vários threads ao mesmo tempo.
+ * Nenhuma função lança exceção nem escreve no console (exceto o aviso do
+ * descompressor para stream de flags truncado).
+ */
+
+#ifndef TENCHUWOH_CAPI_H
+#define TENCHUWOH_CAPI_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <wchar.h>
+
+#if defined(_WIN32)
+#if defined(TWOH_BUILD_DLL)
+#define TWOH_API __declspec(dllexport)
+#elif defined(TWOH_DLL)
+#define TWOH_API __declspec(dllimport)
+#else
+#define TWOH_API
+#endif
+#elif defined(TWOH_BUILD_DLL)
+#define TWOH_API __attribute__((visibility("default")))
+#else
+#define TWOH_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Muda só quando a ABI muda (structs, assinaturas ou significado dos códigos). */
+#define TWOH_API_VERSION 1
+
+typedef enum twoh_status {
+    TWOH_OK = 0,
+    TWOH_ERR_ARGUMENT = -1,         /* Ponteiro nulo, índice fora da lista */
+    TWOH_ERR_IO = -2,               /* Arquivo não abre ou não pôde ser lido */
+    TWOH_ERR_CORRUPT = -3,          /* Bloco LZSS inválido */
+    TWOH_ERR_BUFFER_TOO_SMALL = -4, /* 'capacity' menor que a saída; veja 'written' */
+    TWOH_ERR_OUT_OF_MEMORY = -5
+} twoh_status;
+
+typedef struct twoh_block_info {
+    uint64_t offset;            /* Posição do bloco no container */
+    uint64_t compressed_size;   /* Bytes que o bloco ocupa no container */
+    uint64_t decompressed_size; /* Bytes que ele gera ao descomprimir */
+} twoh_block_info;
+
+typedef struct twoh_container twoh_container;
+
+TWOH_API uint32_t twoh_api_version(void);
+
+/* Texto curto (em português) para um código de status. Nunca devolve NULL. */
+TWOH_API const char* twoh_status_string(int status);
+
+/*
+ * Abre um container já na memória e roda o scanner nele. Os bytes não são
+ * copiados: 'data' precisa continuar válido até twoh_close().
+ */
+TWOH_API int twoh_open_memory(const void* data, size_t size, twoh_container** out);
+
+/*
+ * Abre um container do disco (mapeado na memória) e roda o scanner nele.
+ * 'path' vai direto para o sistema, na codificação nativa (no Windows, a
+ * página de código ANSI, como os argumentos da linha de comando).
+ */
+TWOH_API int twoh_open_file(const char* path, twoh_container** out);
+
+#if defined(_WIN32)
+/*
+ * Igual a twoh_open_file, com o caminho em UTF-16: abre nomes que não
+ * cabem na página de código ANSI.
+ */
+TWOH_API int twoh_open_file_w(const wchar_t* path, twoh_container** out);
+#endif
+
+/*
+ * Código de erro do sistema (errno; no Windows, GetLastError) da última
+ * falha TWOH_ERR_IO neste thread. 0 se não houver.
+ */
+TWOH_API int twoh_last_os_error(void);
+
+/* Aceita NULL. */
+TWOH_API void twoh_close(twoh_container* container);
+
+/* Blocos em ordem de offset, sem sobreposição (o mesmo que o --list mostra). */
+TWOH_API size_t twoh_block_count(const twoh_container* container);
+TWOH_API int twoh_block_info_at(const twoh_container* container, size_t index, twoh_block_info* info);
+
+/*
+ * Bytes comprimidos do bloco, dentro do próprio container (sem cópia).
+ * Valem enquanto o container estiver aberto.
+ */
+TWOH_API int twoh_block_data(const twoh_container* container, size_t index, const void** data, size_t* size);
+
+/*
+ * Descomprime o bloco 'index' em 'dst'. Em sucesso, '*written' recebe o
+ * tamanho da saída; com TWOH_ERR_BUFFER_TOO_SMALL, recebe o tamanho
+ * necessário (decompressed_size) e nada é escrito. 'written' pode ser NULL.
+ */
+TWOH_API int twoh_decode_block(const twoh_container* container, size_t index, void* dst, size_t capacity, size_t* written);
+
+/*
+ * Valida o bloco LZSS que começa em 'data' (sem descomprimir) e preenche
+ * 'info' com offset 0 e os tamanhos dele. TWOH_ERR_CORRUPT se não houver
+ * um bloco válido ali.
+ */
+TWOH_API int twoh_probe_block(const void* data, size_t size, twoh_block_info* info);
+
+/*
+ * Descomprime um bloco avulso (ex.: lido de outro lugar) em 'dst'. Mesmas
+ * regras de twoh_decode_block.
+ */
+TWOH_API int twoh_decode(const void* block, size_t size, void* dst, size_t capacity, size_t* written);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TENCHUWOH_CAPI_H */
@@ -0,0 +1,1176 @@
+#include "TenchuWoH_Internal.h"
+
+#include <array>
+#include <stdexcept>
+#include <cstring>
+#include <thread>
+#ifdef _MSC_VER
+#include <intrin.h>  // _BitScanForward (comprimento de match 8 bytes por vez)
+#endif
+
+// --- Função 1: Descompressor (para EXTRAÇÃO FINAL) ---
+
+static constexpr size_t kDecodeHashStep = 64 * 1024;
+
+// Esta função assume que 'block' é um bloco LZSS *perfeito* e lança
+// uma exceção (throw) se algo der errado.
+//
+// Se 'hash' for passado, a saída é hasheada enquanto é produzida (em
+// pedaços de kDecodeHashStep, ainda quentes no cache), sem uma segunda
+// passada sobre o buffer inteiro.
+//
+// 'Output' é um std::vector ou um CallerBuffer (buffer do chamador, usado
+// pela API C): o laço é o mesmo, só muda onde os bytes vão parar.
+
+/**
+ * @brief Saída num buffer de tamanho fixo, com a mesma interface usada
+ * do std::vector. Passar do fim lança, como os outros erros do bloco.
+ */
+class CallerBuffer {
+public:
+    CallerBuffer(uint8_t* data, size_t capacity) : data_(data), capacity_(capacity) {}
+
+    void reserve(size_t) {}
+    uint8_t* data() { return data_; }
+    size_t size() const { return size_; }
+    void push_back(uint8_t b) {
+        if (size_ == capacity_) throw std::length_error("Buffer de saida pequeno demais para o bloco");
+        data_[size_++] = b;
+    }
+
+private:
+    uint8_t* data_;
+    size_t capacity_;
+    size_t size_ = 0;
+};
+
+template <class Output>
+static void decodeLZSSBlock(ByteView block, Output& out, XXH64* hash) {
+    if (block.size() < 12) {
+        throw std::runtime_error("Bloco pequeno demais para conter o header LZSS");
+    }
+
+    const uint8_t* data = block.data();
+    uint32_t off_literals = *reinterpret_cast<const uint32_t*>(data + 0);
+    uint32_t off_pairs = *reinterpret_cast<const uint32_t*>(data + 4);
+
+    if (off_literals >= block.size() || off_pairs >= block.size() || off_literals < 8) {
+        throw std::runtime_error("Offsets inválidos no header");
+    }
+
+    size_t flags_pos = 8;
+    size_t lit_pos = off_literals;
+    size_t pair_pos = off_pairs;
+
+    std::vector<uint8_t> dict_buf(4096, 0); // 0x1000
+    size_t dict_index = 1;
+
+    out.reserve(block.size() * 4); // Chute inicial
+
+    uint32_t flag_word = 0;
+    uint32_t mask = 0;
+    size_t hashed = 0;
+
+    while (true) {
+        if (mask == 0) {
+            mask = 0x80000000;
+            if (hash && out.size() - hashed >= kDecodeHashStep) {
+                hash->update(out.data() + hashed, out.size() - hashed);
+                hashed = out.size();
+            }
+            if (flags_pos + 4 > off_literals) {
+                // Pode ser o fim normal, mas se não for...
+                if (flags_pos < off_literals)
+                    std::cerr << "Warning: Fim prematuro do stream de flags." << std::endl;
+                break; // Fim do stream de flags
+            }
+            flag_word = *reinterpret_cast<const uint32_t*>(data + flags_pos);
+            flags_pos += 4;
+        }
+
+        bool bit_set = (flag_word & mask) != 0;
+        mask >>= 1;
+
+        if (bit_set) {
+            if (lit_pos >= off_pairs) {
+                throw std::runtime_error("Stream de literais acabou prematuramente");
+            }
+            uint8_t literal = data[lit_pos++];
+            out.push_back(literal);
+            dict_buf[dict_index] = literal;
+            dict_index = (dict_index + 1) & 0xFFF;
+        }
+        else {
+            if (pair_pos + 2 > block.size()) {
+                throw std::runtime_error("Stream de pares acabou prematuramente");
+            }
+            uint16_t pair_val = *reinterpret_cast<const uint16_t*>(data + pair_pos);
+            pair_pos += 2;
+
+            int offset = pair_val >> 4;
+            if (offset == 0) {
+                break; // Terminador
+            }
+
+            int length = (pair_val & 0xF) + 2;
+            for (int i = 0; i < length; i++) {
+                uint8_t b = dict_buf[(offset + i) & 0xFFF];
+                out.push_back(b);
+                dict_buf[dict_index] = b;
+                dict_index = (dict_index + 1) & 0xFFF;
+            }
+        }
+    }
+    if (hash) hash->update(out.data() + hashed, out.size() - hashed);
+}
+
+std::vector<uint8_t> decompressLZSSBlock(ByteView block, XXH64* hash) {
+    std::vector<uint8_t> out;
+    decodeLZSSBlock(block, out, hash);
+    return out;
+}
+
+size_t decompressLZSSBlockInto(ByteView block, uint8_t* out, size_t capacity) {
+    CallerBuffer buffer(out, capacity);
+    decodeLZSSBlock(block, buffer, nullptr);
+    return buffer.size();
+}
+
+
+// --- Função 2: Validador (para o SCANNER) ---
+// 
+// Esta função é "segura": ela não lança exceções, apenas retorna
+// um resultado de validação. Ela roda a descompressão inteira
+// para encontrar o tamanho real (consumido e descomprimido).
+//
+// 'available' é quantos bytes a partir de 'data' estão na memória e
+// 'remainingInFile' quantos existem no arquivo. No scan em janelas o
+// primeiro pode ser menor: um bloco que passe do fim da janela é
+// rejeitado (só acontece se ele for maior que a sobreposição).
+
+DecompressValidationResult validateLZSSBlock(const uint8_t* data, size_t available, uint64_t remainingInFile) {
+    // Não pode nem ler o cabeçalho
+    if (available < 12) {
+        return { false, 0, 0 };
+    }
+
+    uint32_t off_literals = *reinterpret_cast<const uint32_t*>(data + 0);
+    uint32_t off_pairs = *reinterpret_cast<const uint32_t*>(data + 4);
+
+    // Checagem de sanidade (do seu script 'scan_container')
+    if (!(8 <= off_literals && off_literals <= remainingInFile &&
+        8 <= off_pairs && off_pairs <= remainingInFile &&
+        off_pairs >= off_literals)) {
+        return { false, 0, 0 };
+    }
+    if (off_pairs > available) {
+        return { false, 0, 0 };
+    }
+    size_t remainingSize = available;
+
+    size_t flags_pos = 8;
+    size_t lit_pos = off_literals;
+    size_t pair_pos = off_pairs;
+
+    // O tamanho descomprimido não depende do conteúdo do dicionário, então
+    // o validador só conta bytes: nada de alocar/preencher o buffer de 4 KB
+    // para cada candidato (era o custo dominante do scan).
+    size_t decompressedSize = 0;
+
+    uint32_t flag_word = 0;
+    uint32_t mask = 0;
+
+    try {
+        while (true) {
+            if (mask == 0) {
+                mask = 0x80000000;
+                if (flags_pos + 4 > off_literals) break; // Fim do stream de flags
+
+                flag_word = *reinterpret_cast<const uint32_t*>(data + flags_pos);
+                flags_pos += 4;
+            }
+
+            bool bit_set = (flag_word & mask) != 0;
+            mask >>= 1;
+
+            if (bit_set) {
+                if (lit_pos >= off_pairs) break; // Erro de stream
+
+                lit_pos++;
+                decompressedSize++;
+            }
+            else {
+                if (pair_pos + 2 > remainingSize) break; // Erro de stream
+
+                uint16_t pair_val = *reinterpret_cast<const uint16_t*>(data + pair_pos);
+                pair_pos += 2;
+
+                int offset = pair_val >> 4;
+                if (offset == 0) {
+                    // Terminador! Sucesso.
+                    size_t consumed = pair_pos; // O tamanho consumido é até o fim do par terminador
+                    return { true, consumed, decompressedSize };
+                }
+
+                decompressedSize += (pair_val & 0xF) + 2;
+            }
+        }
+    }
+    catch (...) {
+        // Pega qualquer erro de leitura fora dos limites
+        return { false, 0, 0 };
+    }
+
+    // Se chegou aqui, o loop quebrou sem achar um terminador
+    return { false, 0, 0 };
+}
+
+DecompressValidationResult validateAndGetConsumedSize(ByteView fileBuffer, size_t startOffset) {
+    if (startOffset + 12 > fileBuffer.size()) {
+        return { false, 0, 0 };
+    }
+    size_t remaining = fileBuffer.size() - startOffset;
+    return validateLZSSBlock(fileBuffer.data() + startOffset, remaining, remaining);
+}
+
+// --- Função 3: O Scanner (do 'scan_container') ---
+
+/**
+ * @brief Valida todos os offsets alinhados (múltiplos de 4) em [from, to)
+ * e acrescenta os blocos válidos em 'results', sem deduplicar.
+ *
+ * Por padrão 'buffer' é o arquivo inteiro. No scan em janelas ele começa
+ * no offset absoluto 'bufferBase' (múltiplo de 4) de um arquivo com
+ * 'fileSize' bytes; 'from'/'to' são relativos ao buffer e os offsets
+ * gravados em 'results' são absolutos.
+ */
+void scanRange(ByteView buffer, size_t from, size_t to, std::vector<ScanResult>& results, uint64_t& candidates,
+    uint64_t bufferBase, uint64_t fileSize) {
+    size_t avail = buffer.size();
+    if (avail < 12) return;
+    if (fileSize == 0) fileSize = bufferBase + avail;
+    to = std::min(to, avail - 11);
+
+    // Com --trace, o tempo da fatia é dividido em pré-filtro e validação
+    // (somada): um evento por candidato seria caro e enorme.
+    TraceScope trace("scan_range");
+    const bool tracing = trace.active();
+    uint64_t validateNs = 0;
+    uint64_t firstCandidate = candidates;
+    for (size_t off = (from + 3) & ~(size_t)3; off < to; off += 4) { // Pula de 4 em 4 bytes
+        // Checagem rápida de plausibilidade
+        const uint8_t* data = buffer.data() + off;
+        uint32_t ol = *reinterpret_cast<const uint32_t*>(data + 0);
+        uint32_t orf = *reinterpret_cast<const uint32_t*>(data + 4);
+        uint64_t rem = fileSize - (bufferBase + off);
+
+        if (8 <= ol && ol <= rem && 8 <= orf && orf <= rem && orf >= ol) {
+            // Se parece bom, faz a validação completa
+            candidates++;
+            uint64_t t0 = tracing ? traceNow() : 0;
+            DecompressValidationResult res = validateLZSSBlock(data, avail - off, rem);
+            if (tracing) validateNs += traceNow() - t0;
+
+            if (res.success && res.consumedBytes > 0) {
+                results.push_back({ bufferBase + off, res.consumedBytes, res.decompressedSize });
+            }
+        }
+    }
+
+    if (tracing) {
+        uint64_t total = traceNow() - trace.start();
+        uint64_t prefilterNs = total > validateNs ? total - validateNs : 0;
+        traceEvent("prefilter", trace.start(), prefilterNs, "bytes", to > from ? to - from : 0);
+        traceEvent("validate", trace.start() + prefilterNs, validateNs, "candidates", candidates - firstCandidate);
+    }
+}
+
+/**
+ * @brief Ordena os candidatos e remove os que se sobrepõem a um bloco
+ * anterior (guloso por offset, preferindo o bloco maior no mesmo offset).
+ */
+std::vector<ScanResult> dedupScanResults(std::vector<ScanResult>& results) {
+    TraceScope trace("dedup");
+    trace.arg("candidates", results.size());
+    std::sort(results.begin(), results.end());
+
+    // Como os resultados estão ordenados por offset e os blocos mantidos
+    // nunca se sobrepõem, basta comparar com o fim do último bloco mantido
+    // (antes era uma busca linear em todos os intervalos: O(n^2)).
+    std::vector<ScanResult> finalResults;
+    size_t keptEnd = 0;
+
+    for (const auto& r : results) {
+        if (finalResults.empty() || r.offset >= keptEnd) {
+            keptEnd = r.offset + r.consumedSize;
+            finalResults.push_back(r);
+        }
+    }
+    return finalResults;
+}
+
+std::vector<ScanResult> scanContainer(ByteView fileBuffer, ProgressReporter* progress) {
+    TraceScope trace("scan");
+    std::ostream& log = logStream();
+    log << "Escaneando " << fileBuffer.size() << " bytes..." << std::endl;
+    std::vector<ScanResult> results;
+    size_t n = fileBuffer.size();
+    if (n < 12) {
+        return results;
+    }
+
+    // 1. Encontra todos os candidatos
+    // O arquivo é percorrido em fatias: o loop interno não tem nenhum custo
+    // extra e o progresso/cancelamento só é checado entre as fatias.
+    const size_t sliceSize = 4 * 1024 * 1024;
+    uint64_t candidates = 0;
+    size_t scanned = 0;
+    if (progress) progress->begin("scan", n);
+    for (size_t sliceStart = 0; sliceStart < n - 11; sliceStart += sliceSize) {
+        size_t sliceEnd = std::min(n - 11, sliceStart + sliceSize);
+        scanRange(fileBuffer, sliceStart, sliceEnd, results, candidates);
+        scanned = sliceEnd + 11;
+        if (progress) progress->tick(scanned, candidates, results.size());
+        if (cancelRequested()) {
+            std::cerr << "\nScan interrompido pelo usuario no offset 0x" << std::hex << sliceEnd << std::dec << "." << std::endl;
+            break;
+        }
+    }
+    if (progress) progress->end(cancelRequested() ? scanned : n, candidates, results.size());
+    log << "Encontrados " << results.size() << " candidatos..." << std::endl;
+
+    // 2. Deduplicação
+    std::vector<ScanResult> finalResults = dedupScanResults(results);
+
+    log << "Scan concluído. Encontrados " << finalResults.size() << " blocos válidos." << std::endl;
+    return finalResults;
+}
+
+// --- Função 4: Compressor (para REINSERÇÃO) ---
+//
+// Gera exatamente o formato lido por decompressLZSSBlock: cabeçalho com
+// off_literals/off_pairs, palavras de flags de 32 bits (MSB primeiro,
+// 1 = literal), o stream de literais e o de pares de 16 bits (slot
+// absoluto de 12 bits no anel << 4 | comprimento - 2), fechado por um
+// par de offset 0.
+//
+// O anel do descompressor começa zerado e a escrita começa no índice 1,
+// então o byte de saída p vai para o slot (p + 1) & 0xFFF. Um match em p
+// que copia de q < p usa o slot de q e vale enquanto p - q <= 4096. O
+// slot 0 nunca pode ser fonte (offset 0 é o terminador).
+//
+// O buscador padrão é uma hash chain com chave exata nos 2 primeiros bytes
+// (o match mínimo do formato é 2, e um match de 2 já custa 17 bits contra
+// 18 de dois literais). Toda posição é inserida, inclusive as cobertas por
+// matches, então os candidatos de cada posição dependem só da entrada.
+// Os níveis mais altos usam uma árvore binária (LzssBinaryTreeFinder),
+// que não degrada em dados longos e repetitivos.
+
+const CompressLevel kCompressLevels[kMaxCompressLevel + 1] = {
+    { false, 0, 0 },     // 0: só literais
+    { false, 4, 8 },     // 1: guloso, rápido
+    { false, 16, 17 },
+    { true, 16, 17 },    // 3: lazy
+    { true, 32, 17 },
+    { true, 64, 17 },
+    { true, 128, 17 },   // 6: padrão
+    // Daqui para cima a árvore dá a razão do nível 9 com hash chain (ou
+    // melhor) no tempo do nível 6; em dados repetitivos a diferença cresce.
+    { true, 32, 17, false, MatchFinderKind::BinaryTree },
+    { true, 256, 17, false, MatchFinderKind::BinaryTree },
+    { true, 4096, 17, false, MatchFinderKind::BinaryTree }, // 9: janela inteira
+    { false, 1024, 17, true, MatchFinderKind::BinaryTree }, // 10: parse ótimo
+};
+
+// Índice do primeiro byte diferente numa palavra de 8 bytes (v != 0, little-endian).
+inline int lowestSetByte(uint64_t v) {
+#ifdef _MSC_VER
+    unsigned long i;
+#if defined(_M_X64) || defined(_M_ARM64)
+    _BitScanForward64(&i, v);
+#else
+    if (!_BitScanForward(&i, (unsigned long)v)) {
+        _BitScanForward(&i, (unsigned long)(v >> 32));
+        i += 32;
+    }
+#endif
+    return (int)(i / 8);
+#else
+    return __builtin_ctzll(v) / 8;
+#endif
+}
+
+// Estende um match de 'len' até no máximo 'limit' bytes, 8 por vez.
+inline int lzssMatchLength(const uint8_t* a, const uint8_t* b, int len, int limit) {
+    while (len + 8 <= limit) {
+        uint64_t x, y;
+        std::memcpy(&x, a + len, 8);
+        std::memcpy(&y, b + len, 8);
+        if (x != y) return len + lowestSetByte(x ^ y);
+        len += 8;
+    }
+    while (len < limit && a[len] == b[len]) len++;
+    return len;
+}
+
+inline uint16_t lzssRingSlot(size_t pos) {
+    return (uint16_t)((pos + 1) & 0xFFF);
+}
+
+// Tamanho de um bloco com 'literals' literais e 'pairs' pares (sem contar o terminador).
+inline size_t lzssBlockSize(size_t literals, size_t pairs) {
+    size_t flagWords = (literals + pairs + 1 + 31) / 32;
+    return 8 + 4 * flagWords + literals + 2 * (pairs + 1);
+}
+
+/**
+ * @brief Monta o bloco: acumula flags, literais e pares e junta tudo com o
+ * cabeçalho no finish().
+ */
+class LzssBlockBuilder {
+public:
+    explicit LzssBlockBuilder(size_t inputSize) {
+        literals_.reserve(inputSize);
+        flags_.reserve(inputSize / 32 + 1);
+    }
+
+    void literal(uint8_t b) {
+        pushFlag(true);
+        literals_.push_back(b);
+    }
+
+    void match(uint16_t slot, int length) {
+        pushFlag(false);
+        pairs_.push_back((uint16_t)((slot << 4) | (length - kLzssMinMatch)));
+    }
+
+    std::vector<uint8_t> finish() {
+        pushFlag(false); // Terminador
+        pairs_.push_back(0);
+        if (bits_ > 0) flags_.push_back(word_ << (32 - bits_));
+
+        uint32_t offLiterals = (uint32_t)(8 + 4 * flags_.size());
+        uint32_t offPairs = (uint32_t)(offLiterals + literals_.size());
+        std::vector<uint8_t> out;
+        out.reserve(offPairs + 2 * pairs_.size());
+        auto put32 = [&](uint32_t v) { for (int i = 0; i < 4; i++) out.push_back((uint8_t)(v >> (8 * i))); };
+        put32(offLiterals);
+        put32(offPairs);
+        for (uint32_t w : flags_) put32(w);
+        out.insert(out.end(), literals_.begin(), literals_.end());
+        for (uint16_t v : pairs_) {
+            out.push_back((uint8_t)v);
+            out.push_back((uint8_t)(v >> 8));
+        }
+        return out;
+    }
+
+private:
+    void pushFlag(bool bit) {
+        word_ = (word_ << 1) | (bit ? 1u : 0u);
+        if (++bits_ == 32) {
+            flags_.push_back(word_);
+            word_ = 0;
+            bits_ = 0;
+        }
+    }
+
+    std::vector<uint32_t> flags_;
+    std::vector<uint8_t> literals_;
+    std::vector<uint16_t> pairs_;
+    uint32_t word_ = 0;
+    int bits_ = 0;
+};
+
+/**
+ * @brief Hash chain sobre a janela de 4 KB. find(p) deve ser chamado antes
+ * de insert(p), e insert em ordem crescente para todas as posições.
+ */
+class LzssMatchFinder {
+public:
+    explicit LzssMatchFinder(ByteView input) : in_(input), head_(65536, -1), prev_(kLzssWindow, -1) {}
+
+    void reset() {
+        std::fill(head_.begin(), head_.end(), -1);
+        std::fill(prev_.begin(), prev_.end(), -1);
+    }
+
+    void insert(size_t p) {
+        if (p + 1 >= in_.size()) return;
+        uint32_t key = in_[p] | (in_[p + 1] << 8);
+        prev_[p & (kLzssWindow - 1)] = head_[key];
+        head_[key] = (int64_t)p;
+    }
+
+    /**
+     * @brief Maior match em p (o mais próximo, em caso de empate). Retorna
+     * o comprimento (0 se não houver) e o slot da fonte em 'slot'.
+     */
+    int find(size_t p, int chainDepth, int niceLength, uint16_t& slot) const {
+        size_t n = in_.size();
+        if (p + kLzssMinMatch > n) return 0;
+        int limit = (int)std::min<size_t>(kLzssMaxMatch, n - p);
+        int best = 0;
+        int64_t cand = head_[in_[p] | (in_[p + 1] << 8)];
+        const uint8_t* cur = in_.data() + p;
+        while (cand >= 0 && p - (size_t)cand <= kLzssWindow && chainDepth-- > 0) {
+            if (lzssRingSlot((size_t)cand) != 0) {
+                // Chave exata: os 2 primeiros já batem
+                int len = lzssMatchLength(in_.data() + cand, cur, kLzssMinMatch, limit);
+                if (len > best) {
+                    best = len;
+                    slot = lzssRingSlot((size_t)cand);
+                    if (len >= niceLength || len == limit) break;
+                }
+            }
+            cand = prev_[(size_t)cand & (kLzssWindow - 1)];
+        }
+        return best;
+    }
+
+private:
+    ByteView in_;
+    std::vector<int64_t> head_;
+    std::vector<int64_t> prev_;
+};
+
+/**
+ * @brief Árvore binária sobre a janela de 4 KB (como o bt do LZMA): cada
+ * posição nova vira a raiz da árvore da sua chave de 2 bytes, e a descida
+ * que acha os matches é a mesma que reorganiza a árvore. No pior caso
+ * visita 'cutValue' nós por posição, cada um comparado em no máximo 17
+ * bytes, enquanto uma hash chain em dados repetitivos percorre a cadeia
+ * inteira até o limite sem achar nada maior.
+ *
+ * Mesma interface do LzssMatchFinder. find(p) já insere p (o insert(p)
+ * seguinte não faz nada); insert sozinho só reorganiza a árvore. O
+ * resultado depende da ordem de inserção, então os níveis com árvore
+ * sempre passam pela tabela de matches (segmentos fixos).
+ */
+class LzssBinaryTreeFinder {
+public:
+    LzssBinaryTreeFinder(ByteView input, int cutValue)
+        : in_(input), cut_(std::max(1, cutValue)), head_(65536, kEmpty), son_(2 * kCyclic, kEmpty) {}
+
+    void reset() {
+        std::fill(head_.begin(), head_.end(), kEmpty);
+        std::fill(son_.begin(), son_.end(), kEmpty);
+        found_ = kEmpty;
+    }
+
+    void insert(size_t p) {
+        if ((int64_t)p != found_) walk(p, nullptr);
+    }
+
+    int find(size_t p, int, int, uint16_t& slot) {
+        found_ = (int64_t)p;
+        return walk(p, &slot);
+    }
+
+private:
+    static constexpr int64_t kEmpty = -1;
+    static constexpr size_t kCyclic = 2 * kLzssWindow; // Potência de 2 acima da janela
+
+    int walk(size_t p, uint16_t* slot) {
+        const size_t n = in_.size();
+        if (p + kLzssMinMatch > n) return 0;
+        const int limit = (int)std::min<size_t>(kLzssMaxMatch, n - p);
+        const uint8_t* cur = in_.data() + p;
+        uint32_t key = cur[0] | (cur[1] << 8);
+        int64_t cand = head_[key];
+        head_[key] = (int64_t)p;
+        int64_t* left = &son_[2 * (p & (kCyclic - 1))];      // Sufixos menores que o de p
+        int64_t* right = &son_[2 * (p & (kCyclic - 1)) + 1]; // Maiores
+        int leftLen = 0, rightLen = 0, best = 0;
+        for (int visits = cut_;; visits--) {
+            if (cand == kEmpty || p - (size_t)cand > kLzssWindow || visits == 0) {
+                *left = *right = kEmpty;
+                break;
+            }
+            int64_t* pair = &son_[2 * ((size_t)cand & (kCyclic - 1))];
+            const uint8_t* src = in_.data() + cand;
+            int len = lzssMatchLength(src, cur, std::min(leftLen, rightLen), limit);
+            if (slot && len > best && lzssRingSlot((size_t)cand) != 0) {
+                best = len;
+                *slot = lzssRingSlot((size_t)cand);
+            }
+            if (len == limit) {
+                // Mesmo conteúdo até o limite: p ocupa o lugar do candidato.
+                *left = pair[0];
+                *right = pair[1];
+                break;
+            }
+            if (src[len] < cur[len]) {
+                *left = cand;
+                left = &pair[1];
+                cand = *left;
+                leftLen = len;
+            }
+            else {
+                *right = cand;
+                right = &pair[0];
+                cand = *right;
+                rightLen = len;
+            }
+        }
+        return best >= kLzssMinMatch ? best : 0;
+    }
+
+    ByteView in_;
+    int cut_;
+    std::vector<int64_t> head_;
+    std::vector<int64_t> son_;
+    int64_t found_ = kEmpty;
+};
+
+// --- Tabela de Matches em Paralelo ---
+//
+// O parse de um bloco é sequencial, mas o maior match de cada posição só
+// depende dos 4 KB anteriores da entrada (toda posição é inserida no
+// buscador). Então, para um asset grande, a entrada é dividida em
+// segmentos de kMatchTableSegment; cada thread prepara seu buscador com os
+// 4 KB antes do segmento e acha os matches de todas as posições dele. O
+// parse depois só consulta a tabela, e o bloco sai idêntico ao serial.
+// Com a árvore binária (cujo resultado depende do histórico) a tabela é
+// usada mesmo com um thread: os segmentos são fixos, então o bloco não
+// muda com o número de threads.
+
+constexpr size_t kMatchTableSegment = 256 * 1024;
+
+/**
+ * @brief Maior match de cada posição, no formato do par (slot << 4 |
+ * comprimento - 2); 0 = sem match (o slot 0 nunca é fonte). Mesma
+ * interface do LzssMatchFinder, para o parse não saber de onde vem.
+ */
+class LzssMatchTable {
+public:
+    explicit LzssMatchTable(std::vector<uint16_t> table) : table_(std::move(table)) {}
+
+    void insert(size_t) {}
+
+    int find(size_t p, int, int, uint16_t& slot) const {
+        uint16_t v = p < table_.size() ? table_[p] : 0;
+        if (v == 0) return 0;
+        slot = v >> 4;
+        return (v & 0xF) + kLzssMinMatch;
+    }
+
+private:
+    std::vector<uint16_t> table_;
+};
+
+LzssMatchTable buildMatchTable(ByteView input, const CompressLevel& cfg, unsigned threads) {
+    const size_t n = input.size();
+    std::vector<uint16_t> table(n, 0);
+    const size_t segments = (n + kMatchTableSegment - 1) / kMatchTableSegment;
+    std::atomic<size_t> next{ 0 };
+    auto fill = [&](auto& finder) {
+        for (size_t seg; (seg = next.fetch_add(1)) < segments;) {
+            TraceScope trace("match_table");
+            size_t from = seg * kMatchTableSegment;
+            size_t to = std::min(n, from + kMatchTableSegment);
+            finder.reset();
+            for (size_t p = from > kLzssWindow ? from - kLzssWindow : 0; p < from; p++) finder.insert(p);
+            for (size_t p = from; p < to; p++) {
+                uint16_t slot = 0;
+                int len = finder.find(p, cfg.chainDepth, cfg.niceLength, slot);
+                finder.insert(p);
+                if (len >= kLzssMinMatch) table[p] = (uint16_t)((slot << 4) | (len - kLzssMinMatch));
+            }
+        }
+    };
+    auto worker = [&] {
+        if (cfg.finder == MatchFinderKind::BinaryTree) {
+            LzssBinaryTreeFinder finder(input, cfg.chainDepth);
+            fill(finder);
+        }
+        else {
+            LzssMatchFinder finder(input);
+            fill(finder);
+        }
+    };
+    threads = (unsigned)std::max<size_t>(1, std::min<size_t>(threads, segments));
+    std::vector<std::thread> helpers;
+    for (unsigned i = 1; i < threads; i++) helpers.emplace_back(worker);
+    worker();
+    for (auto& t : helpers) t.join();
+    return LzssMatchTable(std::move(table));
+}
+
+std::vector<uint8_t> storeLZSSBlock(ByteView input) {
+    LzssBlockBuilder builder(input.size());
+    for (uint8_t b : input) builder.literal(b);
+    return builder.finish();
+}
+
+/**
+ * @brief Atalho para dados incompressíveis (já comprimidos, ruído): um
+ * guloso rápido nos primeiros 16 KB; se os matches economizariam menos de
+ * 2% dos bits (literal = 9 bits, match = 17), o bloco inteiro sai só com
+ * literais, sem rodar o buscador.
+ */
+static bool looksIncompressible(ByteView input) {
+    const size_t sample = 16 * 1024;
+    if (input.size() < 4 * sample) return false;
+    ByteView head(input.data(), sample);
+    LzssMatchFinder finder(head);
+    size_t savedBits = 0;
+    for (size_t p = 0; p < sample;) {
+        uint16_t slot = 0;
+        int len = finder.find(p, 4, 8, slot);
+        size_t step = len >= kLzssMinMatch ? (size_t)len : 1;
+        if (len >= kLzssMinMatch) savedBits += 9 * len - 17;
+        for (size_t q = p; q < p + step && q < sample; q++) finder.insert(q);
+        p += step;
+    }
+    return savedBits < sample * 9 / 50;
+}
+
+/**
+ * @brief Estende o match em p com o anel zerado: antes da saída chegar ao
+ * byte 4095, os slots acima do último escrito ainda são zero, então uma
+ * sequência de zeros no começo do arquivo pode ser copiada de lá mesmo sem
+ * ter aparecido antes. 'zeroEnd' guarda o fim da sequência de zeros atual
+ * entre uma chamada e outra (posições em ordem crescente).
+ */
+static int zeroRingMatch(ByteView input, size_t p, int len, uint16_t& slot, size_t& zeroEnd) {
+    // Na posição p só os slots 1..p foram escritos: uma fonte s > p com
+    // s + comprimento - 1 <= 4095 lê só zeros.
+    if (p >= kLzssWindow - 1 || input[p] != 0) return len;
+    if (zeroEnd <= p) {
+        zeroEnd = p;
+        while (zeroEnd < input.size() && input[zeroEnd] == 0) zeroEnd++;
+    }
+    int zeroLen = (int)std::min<size_t>({ zeroEnd - p, (size_t)kLzssMaxMatch, kLzssWindow - 1 - p });
+    if (zeroLen > len) {
+        slot = (uint16_t)(p + kLzssMaxMatch < kLzssWindow ? kLzssWindow - kLzssMaxMatch : p + 1);
+        return zeroLen;
+    }
+    return len;
+}
+
+/**
+ * @brief Parse ótimo: programação dinâmica sobre as escolhas literal/match
+ * com os custos exatos do formato (literal = 1 bit de flag + 8, match =
+ * 1 + 16). Como o custo não depende da distância, basta o maior match de
+ * cada posição: todo comprimento de 2 até ele vale com a mesma fonte.
+ * Também usa o anel zerado (zeroRingMatch).
+ */
+template <class Finder>
+static std::vector<uint8_t> compressOptimal(ByteView input, const CompressLevel& cfg, Finder& finder) {
+    const size_t n = input.size();
+    std::vector<uint32_t> cost(n + 1, UINT32_MAX);
+    std::vector<uint8_t> stepLen(n + 1, 0); // Token que termina em i (1 = literal)
+    std::vector<uint16_t> stepSlot(n + 1, 0);
+    cost[0] = 0;
+
+    size_t zeroEnd = 0; // Fim da sequência de zeros que contém p (só no começo)
+    for (size_t p = 0; p < n; p++) {
+        uint16_t slot = 0;
+        int len = finder.find(p, cfg.chainDepth, cfg.niceLength, slot);
+        finder.insert(p);
+        len = zeroRingMatch(input, p, len, slot, zeroEnd);
+
+        uint32_t c = cost[p];
+        if (c + 9 < cost[p + 1]) {
+            cost[p + 1] = c + 9;
+            stepLen[p + 1] = 1;
+        }
+        for (int l = kLzssMinMatch; l <= len; l++) {
+            if (c + 17 < cost[p + l]) {
+                cost[p + l] = c + 17;
+                stepLen[p + l] = (uint8_t)l;
+                stepSlot[p + l] = slot;
+            }
+        }
+    }
+
+    // Caminho de volta a partir do fim, depois emitido na ordem.
+    std::vector<size_t> ends;
+    for (size_t i = n; i > 0; i -= stepLen[i]) ends.push_back(i);
+    LzssBlockBuilder builder(n);
+    for (auto it = ends.rbegin(); it != ends.rend(); ++it) {
+        size_t end = *it;
+        if (stepLen[end] == 1) builder.literal(input[end - 1]);
+        else builder.match(stepSlot[end], stepLen[end]);
+    }
+    return builder.finish();
+}
+
+/**
+ * @brief Parse ótimo em bytes exatos, contando o arredondamento das flags
+ * em palavras de 32 bits (o parse ótimo em bits cobra 1/8 de byte por
+ * token). O estado é (posição, tokens emitidos mod 32): quando o próximo
+ * token abre uma palavra nova ele custa 4 bytes a mais, então às vezes vale
+ * quebrar ou juntar matches para fechar o bloco uma palavra antes. Ganha no
+ * máximo uns poucos bytes sobre compressOptimal, e custa 32 estados por
+ * posição: só entra no ajuste a um tamanho-alvo (compressLZSSBlockToFit).
+ */
+template <class Finder>
+static std::vector<uint8_t> compressExact(ByteView input, const CompressLevel& cfg, Finder& finder) {
+    const size_t n = input.size();
+    std::vector<uint8_t> matchLen(n, 0);
+    std::vector<uint16_t> matchSlot(n, 0);
+    size_t zeroEnd = 0;
+    for (size_t p = 0; p < n; p++) {
+        uint16_t slot = 0;
+        int len = finder.find(p, cfg.chainDepth, cfg.niceLength, slot);
+        finder.insert(p);
+        matchLen[p] = (uint8_t)zeroRingMatch(input, p, len, slot, zeroEnd);
+        matchSlot[p] = slot;
+    }
+
+    // De trás para frente: best[p][m] = menor custo de input[p..n) com m
+    // tokens já emitidos (mod 32). Só as próximas 17 posições ficam na memória.
+    constexpr size_t kRing = kLzssMaxMatch + 1;
+    std::vector<std::array<uint32_t, 32>> best(kRing);
+    std::vector<std::array<uint8_t, 32>> choice(n); // 1 = literal, senão comprimento do match
+    auto wordCost = [](size_t m) -> uint32_t { return m == 0 ? 4 : 0; };
+    for (size_t m = 0; m < 32; m++) best[n % kRing][m] = wordCost(m) + 2; // Terminador
+    for (size_t p = n; p-- > 0;) {
+        std::array<uint32_t, 32>& cur = best[p % kRing];
+        for (size_t m = 0; m < 32; m++) {
+            size_t next = (m + 1) & 31;
+            uint32_t c = best[(p + 1) % kRing][next] + 1;
+            uint8_t pick = 1;
+            for (int l = kLzssMinMatch; l <= matchLen[p]; l++) {
+                uint32_t cm = best[(p + l) % kRing][next] + 2;
+                if (cm < c) {
+                    c = cm;
+                    pick = (uint8_t)l;
+                }
+            }
+            cur[m] = c + wordCost(m);
+            choice[p][m] = pick;
+        }
+    }
+
+    LzssBlockBuilder builder(n);
+    for (size_t p = 0, m = 0; p < n; m = (m + 1) & 31) {
+        uint8_t l = choice[p][m];
+        if (l == 1) builder.literal(input[p]);
+        else builder.match(matchSlot[p], l);
+        p += l;
+    }
+    return builder.finish();
+}
+
+/**
+ * @brief Parse guloso (ou lazy, um passo à frente) dos níveis 1-9.
+ * Sem 'storeFallback' o resultado é sempre o do parse, mesmo se só
+ * literais desse menos (a emulação do encoder original precisa disso).
+ */
+template <class Finder>
+static std::vector<uint8_t> compressGreedy(ByteView input, const CompressLevel& cfg, Finder& finder,
+    bool storeFallback = true) {
+    const size_t n = input.size();
+    LzssBlockBuilder builder(n);
+    size_t literals = 0, pairs = 0;
+    uint16_t slot = 0;
+    size_t p = 0;
+    int len = finder.find(p, cfg.chainDepth, cfg.niceLength, slot);
+    finder.insert(p);
+    while (p < n) {
+        if (len < kLzssMinMatch) {
+            builder.literal(input[p]);
+            literals++;
+            if (++p < n) {
+                len = finder.find(p, cfg.chainDepth, cfg.niceLength, slot);
+                finder.insert(p);
+            }
+            continue;
+        }
+
+        size_t inserted = p + 1; // Próxima posição ainda não inserida
+        if (cfg.lazy && len < cfg.niceLength && p + 1 < n) {
+            uint16_t nextSlot = 0;
+            int nextLen = finder.find(p + 1, cfg.chainDepth, cfg.niceLength, nextSlot);
+            finder.insert(p + 1);
+            inserted = p + 2;
+            if (nextLen > len) {
+                builder.literal(input[p]);
+                literals++;
+                p++;
+                len = nextLen;
+                slot = nextSlot;
+                continue;
+            }
+        }
+
+        builder.match(slot, len);
+        pairs++;
+        for (size_t q = inserted; q < p + len; q++) finder.insert(q);
+        p += len;
+        if (p < n) {
+            len = finder.find(p, cfg.chainDepth, cfg.niceLength, slot);
+            finder.insert(p);
+        }
+    }
+
+    if (storeFallback && lzssBlockSize(literals, pairs) > lzssBlockSize(n, 0)) return storeLZSSBlock(input);
+    return builder.finish();
+}
+
+/**
+ * @brief Comprime 'input' num bloco LZSS do jogo. Níveis 1-2 são gulosos,
+ * 3-9 lazy com buscas cada vez mais fundas (7-10 na árvore binária), 10 é
+ * o parse ótimo; 0 grava só literais. Nunca devolve algo maior que a versão só com literais.
+ * Com 'threads' > 1 e entrada de mais de um segmento, os matches são
+ * achados em paralelo (resultado idêntico ao serial).
+ */
+static std::vector<uint8_t> compressWithLevel(ByteView input, const CompressLevel& cfg, unsigned threads, bool exact = false) {
+    if (cfg.finder == MatchFinderKind::BinaryTree || (threads > 1 && input.size() > kMatchTableSegment)) {
+        LzssMatchTable table = buildMatchTable(input, cfg, threads);
+        if (exact) return compressExact(input, cfg, table);
+        return cfg.optimal ? compressOptimal(input, cfg, table) : compressGreedy(input, cfg, table);
+    }
+    LzssMatchFinder finder(input);
+    if (exact) return compressExact(input, cfg, finder);
+    return cfg.optimal ? compressOptimal(input, cfg, finder) : compressGreedy(input, cfg, finder);
+}
+
+std::vector<uint8_t> compressLZSSBlock(ByteView input, const CompressLevel& cfg, unsigned threads) {
+    TraceScope trace("compress");
+    trace.arg("bytes", input.size());
+    if (cfg.chainDepth == 0 || looksIncompressible(input)) return storeLZSSBlock(input);
+    return compressWithLevel(input, cfg, threads);
+}
+
+std::vector<uint8_t> compressLZSSBlock(ByteView input, int level, unsigned threads) {
+    return compressLZSSBlock(input, kCompressLevels[std::max(0, std::min(level, kMaxCompressLevel))], threads);
+}
+
+// --- Ajuste a um Tamanho-Alvo (--budget / --fit) ---
+//
+// Um chunk editado que comprime para alguns bytes a mais que o espaço
+// original obriga o --repack a realocá-lo. Aqui o bloco é refeito com
+// estratégias cada vez mais caras até caber no orçamento: o nível pedido,
+// lazy com a janela inteira, parse ótimo, parse ótimo com a cadeia inteira
+// (maior match exato em toda posição) e o parse exato em bytes, que
+// remodela os matches em volta das palavras de flags. Ainda assim o
+// formato tem um piso: se nada couber, fica o menor bloco alcançado.
+
+FitResult compressLZSSBlockToFit(ByteView input, size_t budget, int level, unsigned threads) {
+    TraceScope trace("compress_fit");
+    trace.arg("bytes", input.size());
+    static const CompressLevel kFullChain = { false, (int)kLzssWindow, kLzssMaxMatch, true };
+    FitResult result;
+    auto consider = [&](std::vector<uint8_t> block, const char* strategy) {
+        if (result.block.empty() || block.size() < result.block.size()) {
+            result.block = std::move(block);
+            result.strategy = strategy;
+        }
+        result.fits = result.block.size() <= budget;
+        return result.fits;
+    };
+
+    level = std::max(0, std::min(level, kMaxCompressLevel));
+    if (consider(compressLZSSBlock(input, level, threads), "nivel pedido")) return result;
+    if (consider(storeLZSSBlock(input), "so literais")) return result; // O que o probe de incompressível faria
+    if (level < 9 && consider(compressWithLevel(input, kCompressLevels[9], threads), "lazy, janela inteira")) return result;
+    if (level < 10 && consider(compressWithLevel(input, kCompressLevels[10], threads), "parse otimo")) return result;
+    if (consider(compressWithLevel(input, kFullChain, threads), "parse otimo, cadeia inteira")) return result;
+    if (input.size() <= kExactParseLimit) {
+        consider(compressWithLevel(input, kFullChain, threads, true), "parse exato (palavras de flags)");
+    }
+    return result;
+}
+
+// --- Emulação do Encoder Original (--encoder / --verify-encoder) ---
+//
+// Recomprimir um asset intocado com outro encoder muda os bytes do bloco
+// inteiro: patches binários incham e checksums deixam de bater. Aqui o
+// encoder do jogo é descrito por um modelo com as escolhas que mudam o
+// parse de um LZSS deste formato:
+//  - guloso ou lazy (adia um byte se a próxima posição tiver match maior);
+//  - desempate entre fontes de mesmo comprimento: a mais perto ou a mais longe;
+//  - distância máxima (4096, 4095 ou N - F = 4079/4078 nos encoders estilo
+//    Okumura, onde o lookahead ocupa parte do anel);
+//  - match mínimo (2 ou 3);
+//  - se o anel zerado inicial conta como dicionário.
+// O modelo do jogo é inferido rodando todos os candidatos num punhado de
+// blocos do próprio container e ficando com o que reproduz mais blocos
+// byte a byte. A busca é exaustiva (sem limite de cadeia): o resultado só
+// depende do modelo, nunca de heurísticas de velocidade.
+
+/**
+ * @brief Todos os modelos candidatos, do mais comum (guloso, fonte mais
+ * próxima, janela inteira) para o menos: em caso de empate na inferência,
+ * fica o primeiro.
+ */
+std::vector<EncoderModel> encoderModelCandidates() {
+    std::vector<EncoderModel> models;
+    for (bool lazy : { false, true })
+        for (bool farthest : { false, true })
+            for (size_t window : { kLzssWindow, kLzssWindow - 1, kLzssWindow - kLzssMaxMatch, kLzssWindow - kLzssMaxMatch - 1 })
+                for (int minMatch : { 2, 3 })
+                    for (bool zeroRing : { false, true })
+                        models.push_back({ lazy, farthest, window, minMatch, zeroRing });
+    return models;
+}
+
+bool parseEncoderModel(const std::string& name, EncoderModel& model) {
+    for (const auto& m : encoderModelCandidates()) {
+        if (m.name() == name) {
+            model = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Buscador exaustivo da emulação. Trabalha sobre 4096 zeros + a
+ * entrada: a posição virtual -k é o slot do anel que ainda não foi escrito,
+ * então matches no anel zerado e sobrepostos saem da mesma comparação.
+ */
+class EmulationMatchFinder {
+public:
+    EmulationMatchFinder(ByteView input, const EncoderModel& model)
+        : model_(model), x_(kLzssWindow, 0), head_(65536, -1), prev_(2 * kLzssWindow, -1) {
+        x_.insert(x_.end(), input.begin(), input.end());
+        if (model_.zeroRing) {
+            for (size_t v = 0; v < kLzssWindow; v++) insertX(v);
+        }
+    }
+
+    void insert(size_t p) { insertX(p + kLzssWindow); }
+
+    int find(size_t p, int, int, uint16_t& slot) const {
+        size_t xp = p + kLzssWindow;
+        if (xp + 1 >= x_.size()) return 0;
+        int limit = (int)std::min<size_t>(kLzssMaxMatch, x_.size() - xp);
+        int best = 0;
+        const uint8_t* cur = x_.data() + xp;
+        for (int64_t cand = head_[cur[0] | (cur[1] << 8)]; cand >= 0; cand = prev_[(size_t)cand & (prev_.size() - 1)]) {
+            size_t xq = (size_t)cand;
+            if (xp - xq > model_.maxDistance) break;
+            uint16_t candSlot = (uint16_t)((xq + 1) & 0xFFF); // slot de q = xq - 4096
+            if (candSlot == 0) continue;
+            const uint8_t* src = x_.data() + xq;
+            int len = kLzssMinMatch;
+            while (len < limit && src[len] == cur[len]) len++;
+            if (len > best || (model_.farthest && len == best)) {
+                best = len;
+                slot = candSlot;
+                if (!model_.farthest && len == limit) break;
+            }
+        }
+        return best >= model_.minMatch ? best : 0;
+    }
+
+private:
+    void insertX(size_t xq) {
+        if (xq + 1 >= x_.size()) return;
+        uint32_t key = x_[xq] | (x_[xq + 1] << 8);
+        prev_[xq & (prev_.size() - 1)] = head_[key];
+        head_[key] = (int64_t)xq;
+    }
+
+    EncoderModel model_;
+    std::vector<uint8_t> x_;
+    std::vector<int64_t> head_;
+    std::vector<int64_t> prev_;
+};
+
+/**
+ * @brief Comprime como o encoder descrito por 'model': sem probe de
+ * incompressível e sem trocar por só literais quando isso sairia menor.
+ */
+std::vector<uint8_t> compressEmulated(ByteView input, const EncoderModel& model) {
+    TraceScope trace("compress_emulated");
+    trace.arg("bytes", input.size());
+    const CompressLevel cfg = { model.lazy, 0, kLzssMaxMatch + 1 }; // niceLength acima do máximo: o lazy sempre olha à frente
+    EmulationMatchFinder finder(input, model);
+    return compressGreedy(input, cfg, finder, false);
+}
+
+bool loadInputFile(const std::string& inPath, MappedFile& inputData) {
+    if (!inputData.open(inPath)) {
+        std::cerr << "Erro: Nao foi possivel abrir o arquivo de entrada: " << inPath << std::endl;
+        return false;
+    }
+    if (inputData.empty()) {
+        std::cerr << "Erro: O arquivo de entrada esta vazio." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Scan fora da memória: lê o arquivo em janelas de 'windowSize'
+ * bytes mais 'maxBlock' bytes de sobreposição, então o pico de memória
+ * depende da janela e não do tamanho do arquivo.
+ *
+ * Um candidato que começa numa janela é validado com os bytes dela mais a
+ * sobreposição, ou seja, blocos de até 'maxBlock' bytes que atravessam a
+ * borda são encontrados normalmente. O resultado é o mesmo de
+ * scanContainer() para blocos até esse tamanho. Como a deduplicação é
+ * gulosa por offset, cada bloco mantido já é final e 'onBlock' o recebe
+ * enquanto os bytes ainda estão na janela (a extração não precisa reler).
+ */
+std::vector<ScanResult> scanContainerStreaming(FileReader& file, size_t windowSize, size_t maxBlock,
+    ProgressReporter* progress, const BlockCallback& onBlock) {
+    std::ostream& log = logStream();
+    const uint64_t n = file.size();
+    windowSize = std::max<size_t>(windowSize & ~(size_t)3, 4096);
+    log << "Escaneando " << n << " bytes em janelas de " << windowSize / (1024 * 1024) << " MB (sobreposicao de "
+        << maxBlock << " bytes)..." << std::endl;
+
+    std::vector<ScanResult> finalResults;
+    if (n < 12) return finalResults;
+
+    std::vector<uint8_t> buffer(windowSize + maxBlock + 12);
+    uint64_t bufBase = 0;
+    size_t bufLen = 0;
+    std::vector<ScanResult> windowResults;
+    uint64_t candidates = 0, rawCount = 0;
+    uint64_t keptEnd = 0;
+    uint64_t scanned = 0;
+
+    if (progress) progress->begin("scan", n);
+    for (uint64_t base = 0; base < n - 11; base += windowSize) {
+        // Reaproveita a sobreposição já lida e completa a janela.
+        size_t shift = (size_t)std::min<uint64_t>(base - bufBase, bufLen);
+        std::memmove(buffer.data(), buffer.data() + shift, bufLen - shift);
+        bufLen -= shift;
+        bufBase = base;
+        size_t want = (size_t)std::min<uint64_t>(n - base, buffer.size());
+        if (want > bufLen) {
+            TraceScope readTrace("read");
+            readTrace.arg("bytes", want - bufLen);
+            if (!file.readAt(base + bufLen, buffer.data() + bufLen, want - bufLen)) {
+                std::cerr << "\nErro de leitura no offset 0x" << std::hex << base + bufLen << std::dec << "." << std::endl;
+                break;
+            }
+            bufLen = want;
+        }
+
+        ByteView window(buffer.data(), bufLen);
+        scanRange(window, 0, windowSize, windowResults, candidates, base, n);
+        rawCount += windowResults.size();
+
+        // Os resultados de cada janela já saem em ordem de offset.
+        for (const auto& r : windowResults) {
+            if (finalResults.empty() || r.offset >= keptEnd) {
+                keptEnd = r.offset + r.consumedSize;
+                finalResults.push_back(r);
+                if (onBlock) onBlock(r, ByteView(buffer.data() + (r.offset - base), r.consumedSize));
+            }
+        }
+        windowResults.clear();
+
+        scanned = std::min<uint64_t>(n, base + windowSize);
+        if (progress) progress->tick(scanned, candidates, finalResults.size());
+        if (cancelRequested()) {
+            std::cerr << "\nScan interrompido pelo usuario no offset 0x" << std::hex << scanned << std::dec << "." << std::endl;
+            break;
+        }
+    }
+    if (progress) progress->end(scanned, candidates, finalResults.size());
+
+    log << "Encontrados " << rawCount << " candidatos..." << std::endl;
+    log << "Scan concluído. Encontrados " << finalResults.size() << " blocos válidos." << std::endl;
+    return finalResults;
+}
+
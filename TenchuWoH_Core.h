@@ -0,0 +1,141 @@
+// Núcleo do TenchuWoH_DeCompressor: scanner, descompressor e compressor
+// LZSS do container. Este é o header público da biblioteca (twoh_core):
+// só tipos de dados e declarações, sem includes de plataforma nem estado
+// global. A ferramenta de linha de comando e a API C usam também o
+// TenchuWoH_Internal.h (leitura de arquivos, progresso, trace, hash).
+// Gravar os chunks extraídos em disco é papel da ferramenta, não do núcleo.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class XXH64;
+class ProgressReporter;
+
+// --- Estruturas para o Scanner ---
+
+/**
+ * @brief Visão somente-leitura de uma faixa de bytes (ponteiro + tamanho).
+ * Scanner e descompressor trabalham direto sobre o arquivo mapeado, sem cópia.
+ */
+class ByteView {
+public:
+    ByteView() = default;
+    ByteView(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+    ByteView(const std::vector<uint8_t>& v) : data_(v.data()), size_(v.size()) {}
+
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    uint8_t operator[](size_t i) const { return data_[i]; }
+    const uint8_t* begin() const { return data_; }
+    const uint8_t* end() const { return data_ + size_; }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+/**
+ * @brief Resultado de uma tentativa de validação de bloco LZSS.
+ * Usado pelo scanner.
+ */
+struct DecompressValidationResult {
+    bool success = false;
+    size_t consumedBytes = 0;   // Quantos bytes o bloco comprimido ocupa
+    size_t decompressedSize = 0; // Tamanho dos dados descomprimidos
+};
+
+/**
+ * @brief Informação sobre um bloco LZSS válido encontrado pelo scanner.
+ */
+struct ScanResult {
+    uint64_t offset;          // 64 bits: imagens de disco passam de 4 GB mesmo no build Win32
+    size_t consumedSize;
+    size_t decompressedSize;
+
+    // Para ordenação
+    bool operator<(const ScanResult& other) const {
+        if (offset != other.offset) {
+            return offset < other.offset;
+        }
+        // Se offsets são iguais, prefere o bloco maior (consome mais)
+        return consumedSize > other.consumedSize;
+    }
+};
+
+// --- Descompressor e Scanner ---
+
+// Lança std::runtime_error se o bloco estiver corrompido. Com 'hash', a
+// saída é hasheada enquanto é produzida.
+std::vector<uint8_t> decompressLZSSBlock(ByteView block, XXH64* hash = nullptr);
+
+// Igual ao anterior, mas escreve em 'out' (até 'capacity' bytes) e devolve
+// quantos bytes foram escritos. Lança se a saída não couber.
+size_t decompressLZSSBlockInto(ByteView block, uint8_t* out, size_t capacity);
+
+// Não lança: só diz se há um bloco válido em 'data' e o tamanho dele.
+DecompressValidationResult validateLZSSBlock(const uint8_t* data, size_t available, uint64_t remainingInFile);
+DecompressValidationResult validateAndGetConsumedSize(ByteView fileBuffer, size_t startOffset);
+
+void scanRange(ByteView buffer, size_t from, size_t to, std::vector<ScanResult>& results, uint64_t& candidates,
+    uint64_t bufferBase = 0, uint64_t fileSize = 0);
+std::vector<ScanResult> dedupScanResults(std::vector<ScanResult>& results);
+std::vector<ScanResult> scanContainer(ByteView fileBuffer, ProgressReporter* progress = nullptr);
+
+// --- Compressor ---
+
+constexpr int kLzssMinMatch = 2;
+constexpr int kLzssMaxMatch = 17;
+constexpr size_t kLzssWindow = 4096;
+constexpr int kMaxCompressLevel = 10;
+constexpr int kDefaultCompressLevel = 6;
+
+enum class MatchFinderKind {
+    HashChain,
+    BinaryTree,
+};
+
+struct CompressLevel {
+    bool lazy;      // Adia o match se a próxima posição tiver um maior
+    int chainDepth; // Candidatos visitados por posição (na árvore: nós visitados)
+    int niceLength; // Para de procurar (e não adia) ao achar um match desse tamanho
+    bool optimal = false; // Parse ótimo (programação dinâmica) em vez de guloso/lazy
+    MatchFinderKind finder = MatchFinderKind::HashChain;
+};
+
+extern const CompressLevel kCompressLevels[kMaxCompressLevel + 1];
+
+std::vector<uint8_t> storeLZSSBlock(ByteView input);
+std::vector<uint8_t> compressLZSSBlock(ByteView input, const CompressLevel& cfg, unsigned threads = 1);
+std::vector<uint8_t> compressLZSSBlock(ByteView input, int level = kDefaultCompressLevel, unsigned threads = 1);
+
+constexpr size_t kExactParseLimit = 4 * 1024 * 1024; // ~35 bytes de estado por byte de entrada
+
+struct FitResult {
+    std::vector<uint8_t> block; // O menor alcançado, coubesse ou não
+    const char* strategy = "";  // Estratégia que gerou 'block'
+    bool fits = false;
+};
+
+FitResult compressLZSSBlockToFit(ByteView input, size_t budget, int level = kDefaultCompressLevel, unsigned threads = 1);
+
+struct EncoderModel {
+    bool lazy = false;
+    bool farthest = false;     // Desempate: fonte mais distante em vez da mais próxima
+    size_t maxDistance = kLzssWindow;
+    int minMatch = kLzssMinMatch;
+    bool zeroRing = false;     // Matches no anel zerado antes dele ser escrito
+
+    std::string name() const {
+        return std::string(lazy ? "lazy" : "greedy") + (farthest ? "-far" : "-near") + "-w" + std::to_string(maxDistance)
+            + "-m" + std::to_string(minMatch) + (zeroRing ? "-z" : "");
+    }
+};
+
+std::vector<EncoderModel> encoderModelCandidates();
+bool parseEncoderModel(const std::string& name, EncoderModel& model);
+std::vector<uint8_t> compressEmulated(ByteView input, const EncoderModel& model);
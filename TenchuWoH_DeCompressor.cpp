@@ -1,3 +1,5 @@
+#include "TenchuWoH_Internal.h" // Antes de qualquer include: define _FILE_OFFSET_BITS
+
 #include <iostream>
 #include <vector>
 #include <string>
@@ -8,396 +10,4398 @@
 #include <filesystem>   // Para criar diretórios (C++17)
 #include <sstream>      // Para formatar nomes de arquivos
 #include <iomanip>      // Para std::setw, std::setfill
+#include <cctype>       // Para std::tolower
+#include <cstdio>       // Para std::snprintf
+#include <unordered_map> // Índice de hashes do re-scan incremental
+#include <unordered_set> // Conteúdos já vistos no modo --dedup
+#include <map>          // Espaço livre por tamanho no --repack
+#include <array>
+#include <atomic>       // Flag de cancelamento (SIGINT)
+#include <chrono>       // Medição de throughput / ETA
+#include <csignal>      // Para std::signal (Ctrl+C)
+#include <cstring>      // Para std::memmove
+#include <functional>   // Callback do scanner em janelas
+#include <thread>       // Estágio de escrita assíncrona
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>       // std::unique_ptr
+#include <type_traits>  // Conversão do valor dos flags numéricos
+#include <cerrno>
 
 // --- INCLUDES PARA CODIFICAÇÃO (Windows) ---
 #include <clocale> // Para setlocale
 #ifdef _WIN32
+#define NOMINMAX     // Senão as macros min/max quebram std::min/std::max
 #include <windows.h> // Para SetConsoleOutputCP e CP_UTF8
+#include <io.h>      // _setmode (stdout binário no --extract-at)
+#include <fcntl.h>   // _O_BINARY
+#else
+#include <fcntl.h>    // open
+#include <sys/mman.h> // mmap / madvise
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // read / close
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h> // Backend io_uring do escritor (sem liburing: syscalls diretas)
+#include <sys/syscall.h>
+#define TWOH_HAVE_IO_URING 1
+#endif
+#endif
 #endif
 // ----------------------------------------
 
-// --- Estruturas para o Scanner ---
+// --- Cancelamento (Ctrl+C) ---
+
+extern "C" void onSigInt(int) {
+    g_cancelRequested.store(true, std::memory_order_relaxed);
+    // Um segundo Ctrl+C encerra na hora (comportamento padrão).
+    std::signal(SIGINT, SIG_DFL);
+}
+
+// --- Opções da Linha de Comando ---
 
 /**
- * @brief Resultado de uma tentativa de validação de bloco LZSS.
- * Usado pelo scanner.
+ * @brief Estágio escritor da extração (ver OutputWriter).
  */
-struct DecompressValidationResult {
-    bool success = false;
-    size_t consumedBytes = 0;   // Quantos bytes o bloco comprimido ocupa
-    size_t decompressedSize = 0; // Tamanho dos dados descomprimidos
+enum class WriterBackend { Auto, Sync, Threads, IoUring };
+
+struct WriterOptions {
+    WriterBackend backend = WriterBackend::Auto;
+    unsigned threads = 2;
+    size_t queueItems = 256;
+    size_t queueBytes = 256 * 1024 * 1024;
 };
 
 /**
- * @brief Informação sobre um bloco LZSS válido encontrado pelo scanner.
+ * @brief Opções de processamento passadas pela linha de comando.
  */
-struct ScanResult {
-    size_t offset;
-    size_t consumedSize;
-    size_t decompressedSize;
+struct ProcessOptions {
+    ProgressMode progressMode = ProgressMode::Console;
+    unsigned progressIntervalMs = 500;
+    size_t streamWindow = 0; // > 0: força o scan em janelas (bytes por janela)
+    size_t maxBlock = 0;     // Maior bloco LZSS aceito (0 = padrão de cada modo)
+    WriterOptions writer;
+    bool packOutput = false; // --pack: um arquivo único com índice em vez de chunks soltos
+    bool skipUnchanged = true; // --force desliga: regrava mesmo chunks idênticos aos do disco
+    bool dedup = false; // --dedup: conteúdos repetidos gravados uma vez e ligados por hardlink
+    unsigned jobs = 0;  // --jobs (modo --batch); 0 = um por núcleo
+    bool quiet = false; // --quiet (modo --batch): só erros e o resumo final
+    std::string compressCache; // --cache (modo --compress-dir); vazio = <saida>/.cache
+    bool useCompressCache = true; // --no-cache desliga
+};
 
-    // Para ordenação
-    bool operator<(const ScanResult& other) const {
-        if (offset != other.offset) {
-            return offset < other.offset;
-        }
-        // Se offsets são iguais, prefere o bloco maior (consome mais)
-        return consumedSize > other.consumedSize;
+// Padrões do scan em janelas: 64 MB por janela e até 16 MB de sobreposição
+// (= maior bloco comprimido que ainda é encontrado).
+static const size_t kDefaultStreamWindow = 64 * 1024 * 1024;
+static const size_t kDefaultStreamMaxBlock = 16 * 1024 * 1024;
+
+/**
+ * @brief Lê um inteiro sem sinal da linha de comando. Falha (false) com
+ * texto vazio, sinal, lixo depois dos dígitos ou valor fora de
+ * [minValue, maxValue]. 'base' 0 aceita também 0x... (offsets).
+ */
+bool parseUnsigned(const std::string& text, uint64_t minValue, uint64_t maxValue, uint64_t& out, int base = 10) {
+    if (text.empty() || !std::isxdigit((unsigned char)text[0])) return false; // stoull aceitaria " 5" e "-1"
+    try {
+        size_t used = 0;
+        uint64_t v = std::stoull(text, &used, base);
+        if (used != text.size() || v < minValue || v > maxValue) return false;
+        out = v;
+        return true;
     }
-};
+    catch (const std::exception&) {
+        return false;
+    }
+}
 
-// --- Função 1: Descompressor (para EXTRAÇÃO FINAL) ---
+// --- Manifesto de Blocos (modos --list / --manifest) ---
+//
+// Guarda só o resultado do scan (offset, tamanho comprimido e
+// descomprimido), sem descomprimir nada. Formatos:
+//   JSON: { "source": ..., "size": N, "blocks": [ {"offset":..,"consumed":..,"decompressed":..}, ... ] }
+//   CSV:  offset,offset_hex,consumed_size,decompressed_size
+//   Binário (little-endian): "TWMF", u32 versão, u64 tamanho da fonte,
+//         u64 contagem, e contagem * { u64 offset, u64 consumido, u64 descomprimido }
 
-// Esta função assume que 'block' é um bloco LZSS *perfeito* e lança
-// uma exceção (throw) se algo der errado.
+enum class ManifestFormat { Json, Csv, Binary };
 
-std::vector<uint8_t> decompressLZSSBlock(const std::vector<uint8_t>& block) {
-    if (block.size() < 12) {
-        throw std::runtime_error("Bloco pequeno demais para conter o header LZSS");
-    }
+static const char kManifestMagic[4] = { 'T', 'W', 'M', 'F' };
+static const uint32_t kManifestVersion = 1;
 
-    const uint8_t* data = block.data();
-    uint32_t off_literals = *reinterpret_cast<const uint32_t*>(data + 0);
-    uint32_t off_pairs = *reinterpret_cast<const uint32_t*>(data + 4);
+bool parseManifestFormat(const std::string& name, ManifestFormat& fmt) {
+    if (name == "json") fmt = ManifestFormat::Json;
+    else if (name == "csv") fmt = ManifestFormat::Csv;
+    else if (name == "bin") fmt = ManifestFormat::Binary;
+    else return false;
+    return true;
+}
 
-    if (off_literals >= block.size() || off_pairs >= block.size() || off_literals < 8) {
-        throw std::runtime_error("Offsets inválidos no header");
-    }
+// Deduz o formato pela extensão; JSON quando não reconhecida.
+ManifestFormat manifestFormatFromPath(const std::string& path) {
+    std::string ext = std::filesystem::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    if (ext == ".csv") return ManifestFormat::Csv;
+    if (ext == ".bin" || ext == ".twmf") return ManifestFormat::Binary;
+    return ManifestFormat::Json;
+}
 
-    size_t flags_pos = 8;
-    size_t lit_pos = off_literals;
-    size_t pair_pos = off_pairs;
+std::string jsonEscape(const std::string& str) {
+    std::string out;
+    out.reserve(str.size());
+    for (unsigned char c : str) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (c < 0x20) {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out += buf;
+            }
+            else {
+                out += (char)c;
+            }
+        }
+    }
+    return out;
+}
 
-    std::vector<uint8_t> dict_buf(4096, 0); // 0x1000
-    size_t dict_index = 1;
+template <typename T>
+void writeLE(std::ostream& os, T value) {
+    uint8_t bytes[sizeof(T)];
+    for (size_t i = 0; i < sizeof(T); i++) bytes[i] = (uint8_t)(value >> (8 * i));
+    os.write(reinterpret_cast<const char*>(bytes), sizeof(T));
+}
 
-    std::vector<uint8_t> out;
-    out.reserve(block.size() * 4); // Chute inicial
+template <typename T>
+bool readLE(std::istream& is, T& value) {
+    uint8_t bytes[sizeof(T)];
+    if (!is.read(reinterpret_cast<char*>(bytes), sizeof(T))) return false;
+    value = 0;
+    for (size_t i = 0; i < sizeof(T); i++) value |= (T)bytes[i] << (8 * i);
+    return true;
+}
 
-    uint32_t flag_word = 0;
-    uint32_t mask = 0;
+// Bytes que ainda restam em 'is': contagens lidas de um cabeçalho são
+// conferidas contra isso antes de reservar memória para elas.
+uint64_t bytesLeft(std::istream& is) {
+    std::streampos here = is.tellg();
+    is.seekg(0, std::ios::end);
+    std::streampos end = is.tellg();
+    is.seekg(here);
+    return (here < 0 || end < here) ? 0 : (uint64_t)(end - here);
+}
 
-    while (true) {
-        if (mask == 0) {
-            mask = 0x80000000;
-            if (flags_pos + 4 > off_literals) {
-                // Pode ser o fim normal, mas se não for...
-                if (flags_pos < off_literals)
-                    std::cerr << "Warning: Fim prematuro do stream de flags." << std::endl;
-                break; // Fim do stream de flags
-            }
-            flag_word = *reinterpret_cast<const uint32_t*>(data + flags_pos);
-            flags_pos += 4;
+void writeManifest(std::ostream& os, const std::vector<ScanResult>& blocks, ManifestFormat fmt,
+    const std::string& source, uint64_t sourceSize) {
+    switch (fmt) {
+    case ManifestFormat::Json:
+        os << "{\n  \"source\": \"" << jsonEscape(source) << "\",\n  \"size\": " << sourceSize
+            << ",\n  \"blocks\": [";
+        for (size_t i = 0; i < blocks.size(); i++) {
+            os << (i ? ",\n    " : "\n    ") << "{\"offset\": " << blocks[i].offset
+                << ", \"consumed\": " << blocks[i].consumedSize
+                << ", \"decompressed\": " << blocks[i].decompressedSize << "}";
+        }
+        os << (blocks.empty() ? "]\n}\n" : "\n  ]\n}\n");
+        break;
+    case ManifestFormat::Csv:
+        os << "offset,offset_hex,consumed_size,decompressed_size\n";
+        for (const auto& b : blocks) {
+            os << b.offset << ",0x" << std::hex << std::setfill('0') << std::setw(8) << b.offset
+                << std::dec << std::setfill(' ') << "," << b.consumedSize << "," << b.decompressedSize << "\n";
         }
+        break;
+    case ManifestFormat::Binary:
+        os.write(kManifestMagic, sizeof(kManifestMagic));
+        writeLE<uint32_t>(os, kManifestVersion);
+        writeLE<uint64_t>(os, sourceSize);
+        writeLE<uint64_t>(os, blocks.size());
+        for (const auto& b : blocks) {
+            writeLE<uint64_t>(os, b.offset);
+            writeLE<uint64_t>(os, b.consumedSize);
+            writeLE<uint64_t>(os, b.decompressedSize);
+        }
+        break;
+    }
+}
 
-        bool bit_set = (flag_word & mask) != 0;
-        mask >>= 1;
+/**
+ * @brief Lê um manifesto gravado por writeManifest (qualquer formato).
+ * Lança std::runtime_error se o arquivo não puder ser interpretado.
+ */
+std::vector<ScanResult> readManifest(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Nao foi possivel abrir o manifesto: " + path);
+    }
+    std::vector<ScanResult> blocks;
 
-        if (bit_set) {
-            if (lit_pos >= off_pairs) {
-                throw std::runtime_error("Stream de literais acabou prematuramente");
-            }
-            uint8_t literal = data[lit_pos++];
-            out.push_back(literal);
-            dict_buf[dict_index] = literal;
-            dict_index = (dict_index + 1) & 0xFFF;
+    char magic[4] = {};
+    in.read(magic, sizeof(magic));
+    if (in && std::equal(magic, magic + 4, kManifestMagic)) {
+        uint32_t version = 0;
+        uint64_t sourceSize = 0, count = 0;
+        if (!readLE(in, version) || version != kManifestVersion || !readLE(in, sourceSize) || !readLE(in, count)) {
+            throw std::runtime_error("Cabecalho de manifesto binario invalido");
         }
-        else {
-            if (pair_pos + 2 > block.size()) {
-                throw std::runtime_error("Stream de pares acabou prematuramente");
+        if (count > bytesLeft(in) / 24) throw std::runtime_error("Manifesto binario truncado");
+        blocks.reserve((size_t)count);
+        for (uint64_t i = 0; i < count; i++) {
+            uint64_t off, consumed, dec;
+            if (!readLE(in, off) || !readLE(in, consumed) || !readLE(in, dec)) {
+                throw std::runtime_error("Manifesto binario truncado");
             }
-            uint16_t pair_val = *reinterpret_cast<const uint16_t*>(data + pair_pos);
-            pair_pos += 2;
+            blocks.push_back({ (size_t)off, (size_t)consumed, (size_t)dec });
+        }
+        return blocks;
+    }
 
-            int offset = pair_val >> 4;
-            if (offset == 0) {
-                break; // Terminador
-            }
+    in.clear();
+    in.seekg(0);
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
 
-            int length = (pair_val & 0xF) + 2;
-            for (int i = 0; i < length; i++) {
-                uint8_t b = dict_buf[(offset + i) & 0xFFF];
-                out.push_back(b);
-                dict_buf[dict_index] = b;
-                dict_index = (dict_index + 1) & 0xFFF;
+    if (text.compare(0, 6, "offset") == 0) {
+        // CSV: pula o cabeçalho; a primeira coluna é o offset decimal.
+        std::istringstream lines(text);
+        std::string line;
+        std::getline(lines, line);
+        while (std::getline(lines, line)) {
+            if (line.empty() || line == "\r") continue;
+            std::istringstream fields(line);
+            std::string off, hex, consumed, dec;
+            if (!std::getline(fields, off, ',') || !std::getline(fields, hex, ',') ||
+                !std::getline(fields, consumed, ',') || !std::getline(fields, dec, ',')) {
+                throw std::runtime_error("Linha CSV invalida no manifesto: " + line);
             }
+            blocks.push_back({ (size_t)std::stoull(off), (size_t)std::stoull(consumed), (size_t)std::stoull(dec) });
         }
+        return blocks;
     }
-    return out;
+
+    // JSON: só precisamos dos objetos dentro de "blocks".
+    size_t pos = text.find("\"blocks\"");
+    if (pos == std::string::npos) {
+        throw std::runtime_error("Manifesto em formato desconhecido: " + path);
+    }
+    auto field = [&](size_t from, const char* key, size_t limit) -> size_t {
+        size_t k = text.find(key, from);
+        if (k == std::string::npos || k > limit) {
+            throw std::runtime_error(std::string("Campo ausente no manifesto JSON: ") + key);
+        }
+        k = text.find(':', k);
+        return (size_t)std::stoull(text.substr(k + 1, 24));
+    };
+    while ((pos = text.find('{', pos)) != std::string::npos) {
+        size_t close = text.find('}', pos);
+        if (close == std::string::npos) break;
+        blocks.push_back({ field(pos, "\"offset\"", close), field(pos, "\"consumed\"", close),
+            field(pos, "\"decompressed\"", close) });
+        pos = close;
+    }
+    return blocks;
 }
 
+/**
+ * @brief Modo somente-scan: gera o manifesto de blocos sem descomprimir e
+ * sem criar o diretório de saída. Com 'manifestPath' vazio escreve no stdout.
+ */
+bool listContainerFile(const std::string& inPath, const std::string& manifestPath, ManifestFormat fmt,
+    const ProcessOptions& opts = {}) {
+    ProgressReporter progress(opts.progressMode, opts.progressIntervalMs);
+    std::vector<ScanResult> blocks;
+    uint64_t inputSize = 0;
+
+    MappedFile inputData;
+    if (opts.streamWindow == 0 && inputData.open(inPath) && !inputData.empty()) {
+        inputSize = inputData.size();
+        blocks = scanContainer(inputData.view(), &progress);
+    }
+    else {
+        FileReader reader;
+        if (!reader.open(inPath)) {
+            std::cerr << "Erro: Nao foi possivel abrir o arquivo de entrada: " << inPath << std::endl;
+            return false;
+        }
+        inputSize = reader.size();
+        blocks = scanContainerStreaming(reader, opts.streamWindow ? opts.streamWindow : kDefaultStreamWindow,
+            opts.maxBlock ? opts.maxBlock : kDefaultStreamMaxBlock, &progress);
+    }
+    if (cancelRequested()) {
+        std::cerr << "Cancelado: manifesto nao foi gravado." << std::endl;
+        return false;
+    }
 
-// --- Função 2: Validador (para o SCANNER) ---
-// 
-// Esta função é "segura": ela não lança exceções, apenas retorna
-// um resultado de validação. Ela roda a descompressão inteira
-// para encontrar o tamanho real (consumido e descomprimido).
+    if (manifestPath.empty()) {
+        writeManifest(std::cout, blocks, fmt, inPath, inputSize);
+        std::cout.flush();
+        return true;
+    }
 
-DecompressValidationResult validateAndGetConsumedSize(const std::vector<uint8_t>& fileBuffer, size_t startOffset) {
-    // Não pode nem ler o cabeçalho
-    if (startOffset + 12 > fileBuffer.size()) {
-        return { false, 0, 0 };
+    std::ofstream out(manifestPath, std::ios::binary);
+    if (!out) {
+        std::cerr << "Erro: Nao foi possivel criar o manifesto: " << manifestPath << std::endl;
+        return false;
+    }
+    writeManifest(out, blocks, fmt, inPath, inputSize);
+    out.close();
+    if (!out) {
+        std::cerr << "Erro: Falha ao gravar o manifesto: " << manifestPath << std::endl;
+        return false;
     }
+    logStream() << "Manifesto gravado em: " << manifestPath << " (" << blocks.size() << " blocos)" << std::endl;
+    return true;
+}
 
-    const uint8_t* data = fileBuffer.data() + startOffset;
-    size_t remainingSize = fileBuffer.size() - startOffset;
+// --- Re-scan Incremental (modos --hashmap / --rescan) ---
+//
+// Quando só alguns trechos de um container grande mudam, não é preciso
+// escanear tudo de novo. A versão antiga é resumida num mapa de hashes por
+// bloco (hash rolante + XXH64); o arquivo novo é percorrido com o hash
+// rolante (estilo rsync) para achar os trechos que continuam iguais, mesmo
+// deslocados. Os ScanResults antigos que caem inteiros nesses trechos são
+// reaproveitados e só os offsets perto das mudanças são validados de novo.
+//
+// O resultado é idêntico a um scan completo desde que nenhum bloco válido
+// seja maior que 'maxBlock' (por padrão, o maior bloco do manifesto antigo).
+
+struct BlockHashMap {
+    uint32_t blockSize = 0;
+    uint64_t fileSize = 0;
+    std::vector<uint64_t> weak;   // Hash rolante de cada bloco alinhado
+    std::vector<uint64_t> strong; // XXH64 do mesmo bloco
+};
 
-    uint32_t off_literals = *reinterpret_cast<const uint32_t*>(data + 0);
-    uint32_t off_pairs = *reinterpret_cast<const uint32_t*>(data + 4);
+static const char kHashMapMagic[4] = { 'T', 'W', 'H', 'M' };
+static const uint32_t kHashMapVersion = 1;
+static const uint32_t kDefaultHashBlock = 4096;
 
-    // Checagem de sanidade (do seu script 'scan_container')
-    if (!(8 <= off_literals && off_literals <= remainingSize &&
-        8 <= off_pairs && off_pairs <= remainingSize &&
-        off_pairs >= off_literals)) {
-        return { false, 0, 0 };
+/**
+ * @brief Hash polinomial rolante (mod 2^64) sobre uma janela de tamanho fixo.
+ */
+class RollingHash {
+public:
+    explicit RollingHash(size_t window) {
+        for (size_t i = 1; i < window; i++) outPow_ *= kBase;
     }
 
-    size_t flags_pos = 8;
-    size_t lit_pos = off_literals;
-    size_t pair_pos = off_pairs;
+    static uint64_t compute(const uint8_t* p, size_t len) {
+        uint64_t h = 0;
+        for (size_t i = 0; i < len; i++) h = h * kBase + p[i];
+        return h;
+    }
 
-    std::vector<uint8_t> dict_buf(4096, 0); // 0x1000
-    size_t dict_index = 1;
-    size_t decompressedSize = 0;
+    // Remove 'out' (o byte mais antigo) e acrescenta 'in'.
+    uint64_t roll(uint64_t h, uint8_t out, uint8_t in) const {
+        return (h - out * outPow_) * kBase + in;
+    }
 
-    uint32_t flag_word = 0;
-    uint32_t mask = 0;
+private:
+    static constexpr uint64_t kBase = 0x100000001B3ULL;
+    uint64_t outPow_ = 1;
+};
 
-    try {
-        while (true) {
-            if (mask == 0) {
-                mask = 0x80000000;
-                if (flags_pos + 4 > off_literals) break; // Fim do stream de flags
+BlockHashMap buildBlockHashMap(ByteView data, uint32_t blockSize) {
+    BlockHashMap map;
+    map.blockSize = blockSize;
+    map.fileSize = data.size();
+    size_t count = data.size() / blockSize;
+    map.weak.resize(count);
+    map.strong.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* p = data.data() + i * blockSize;
+        map.weak[i] = RollingHash::compute(p, blockSize);
+        map.strong[i] = XXH64::hash(p, blockSize);
+    }
+    return map;
+}
 
-                flag_word = *reinterpret_cast<const uint32_t*>(data + flags_pos);
-                flags_pos += 4;
-            }
+bool writeBlockHashMap(const std::string& path, const BlockHashMap& map) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) return false;
+    out.write(kHashMapMagic, sizeof(kHashMapMagic));
+    writeLE<uint32_t>(out, kHashMapVersion);
+    writeLE<uint32_t>(out, map.blockSize);
+    writeLE<uint64_t>(out, map.fileSize);
+    writeLE<uint64_t>(out, map.weak.size());
+    for (size_t i = 0; i < map.weak.size(); i++) {
+        writeLE<uint64_t>(out, map.weak[i]);
+        writeLE<uint64_t>(out, map.strong[i]);
+    }
+    out.close();
+    return (bool)out;
+}
+
+/**
+ * @brief Lê um mapa de hashes. Retorna false (sem mensagem) se o arquivo
+ * não começar com a assinatura "TWHM"; lança se estiver corrompido.
+ */
+bool readBlockHashMap(const std::string& path, BlockHashMap& map) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[4] = {};
+    if (!in.read(magic, sizeof(magic)) || !std::equal(magic, magic + 4, kHashMapMagic)) {
+        return false;
+    }
+    uint32_t version = 0;
+    uint64_t count = 0;
+    if (!readLE(in, version) || version != kHashMapVersion || !readLE(in, map.blockSize) ||
+        !readLE(in, map.fileSize) || !readLE(in, count) || map.blockSize == 0) {
+        throw std::runtime_error("Cabecalho de mapa de hashes invalido: " + path);
+    }
+    if (count > bytesLeft(in) / 16) throw std::runtime_error("Mapa de hashes truncado: " + path);
+    map.weak.resize((size_t)count);
+    map.strong.resize((size_t)count);
+    for (uint64_t i = 0; i < count; i++) {
+        if (!readLE(in, map.weak[i]) || !readLE(in, map.strong[i])) {
+            throw std::runtime_error("Mapa de hashes truncado: " + path);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Trecho do arquivo novo igual a um trecho do antigo.
+ */
+struct MatchedSegment {
+    size_t newStart;
+    size_t oldStart;
+    size_t length;
+};
+
+/**
+ * @brief Acha os trechos do arquivo novo que existem no antigo (estilo rsync).
+ *
+ * Só são mantidos trechos cujo deslocamento é múltiplo de 4: o scanner só
+ * testa offsets alinhados, então um bloco deslocado de 1-3 bytes não seria
+ * encontrado no mesmo lugar por um scan completo.
+ */
+std::vector<MatchedSegment> matchAgainstHashMap(ByteView data, const BlockHashMap& map) {
+    std::vector<MatchedSegment> segments;
+    const size_t bs = map.blockSize;
+    const size_t n = data.size();
+    if (map.weak.empty() || n < bs) return segments;
 
-            bool bit_set = (flag_word & mask) != 0;
-            mask >>= 1;
+    // Índice hash fraco -> blocos antigos, com um filtro de bits na frente
+    // para que as posições alteradas (que rolam byte a byte) quase nunca
+    // precisem consultar o unordered_map.
+    const int filterBits = 22;
+    std::vector<uint64_t> filter((size_t)1 << (filterBits - 6), 0);
+    auto filterSlot = [&](uint64_t h) { return (size_t)((h * 0x9E3779B97F4A7C15ULL) >> (64 - filterBits)); };
+    std::unordered_map<uint64_t, std::vector<uint32_t>> index;
+    index.reserve(map.weak.size());
+    for (size_t i = 0; i < map.weak.size(); i++) {
+        index[map.weak[i]].push_back((uint32_t)i);
+        size_t slot = filterSlot(map.weak[i]);
+        filter[slot >> 6] |= 1ULL << (slot & 63);
+    }
 
-            if (bit_set) {
-                if (lit_pos >= off_pairs) break; // Erro de stream
+    RollingHash roller(bs);
+    size_t p = 0;
+    uint64_t h = RollingHash::compute(data.data(), bs);
+    size_t nextOld = SIZE_MAX; // Bloco antigo que continuaria o último trecho
 
-                uint8_t literal = data[lit_pos++];
-                decompressedSize++;
-                dict_buf[dict_index] = literal;
-                dict_index = (dict_index + 1) & 0xFFF;
+    while (true) {
+        size_t slot = filterSlot(h);
+        long long found = -1;
+        if (filter[slot >> 6] & (1ULL << (slot & 63))) {
+            uint64_t strong = 0;
+            bool strongDone = false;
+            auto strongOf = [&]() {
+                if (!strongDone) { strong = XXH64::hash(data.data() + p, bs); strongDone = true; }
+                return strong;
+            };
+            // Prefere continuar o trecho anterior (caso comum: nada mudou aqui).
+            if (nextOld < map.weak.size() && map.weak[nextOld] == h && map.strong[nextOld] == strongOf()) {
+                found = (long long)nextOld;
             }
             else {
-                if (pair_pos + 2 > remainingSize) break; // Erro de stream
-
-                uint16_t pair_val = *reinterpret_cast<const uint16_t*>(data + pair_pos);
-                pair_pos += 2;
-
-                int offset = pair_val >> 4;
-                if (offset == 0) {
-                    // Terminador! Sucesso.
-                    size_t consumed = pair_pos; // O tamanho consumido é até o fim do par terminador
-                    return { true, consumed, decompressedSize };
+                auto it = index.find(h);
+                if (it != index.end()) {
+                    for (uint32_t idx : it->second) {
+                        if ((p - (size_t)idx * bs) % 4 == 0 && map.strong[idx] == strongOf()) {
+                            found = idx;
+                            break;
+                        }
+                    }
                 }
+            }
+        }
 
-                int length = (pair_val & 0xF) + 2;
-                for (int i = 0; i < length; i++) {
-                    uint8_t b = dict_buf[(offset + i) & 0xFFF];
-                    decompressedSize++;
-                    dict_buf[dict_index] = b;
-                    dict_index = (dict_index + 1) & 0xFFF;
-                }
+        if (found >= 0 && (p - (size_t)found * bs) % 4 == 0) {
+            size_t oldStart = (size_t)found * bs;
+            MatchedSegment* last = segments.empty() ? nullptr : &segments.back();
+            if (last && last->newStart + last->length == p && last->oldStart + last->length == oldStart) {
+                last->length += bs;
             }
+            else {
+                segments.push_back({ p, oldStart, bs });
+            }
+            nextOld = (size_t)found + 1;
+            p += bs;
+            if (p + bs > n) break;
+            h = RollingHash::compute(data.data() + p, bs);
+        }
+        else {
+            if (p + bs >= n) break;
+            h = roller.roll(h, data[p], data[p + bs]);
+            p++;
         }
     }
-    catch (...) {
-        // Pega qualquer erro de leitura fora dos limites
-        return { false, 0, 0 };
-    }
-
-    // Se chegou aqui, o loop quebrou sem achar um terminador
-    return { false, 0, 0 };
+    return segments;
 }
 
-// --- Função 3: O Scanner (do 'scan_container') ---
+struct RescanStats {
+    size_t segments = 0;
+    uint64_t unchangedBytes = 0;
+    uint64_t rescannedBytes = 0;
+    size_t reusedBlocks = 0;
+    int passes = 0;
+};
+
+using Interval = std::pair<size_t, size_t>; // [first, second)
 
-std::vector<ScanResult> scanContainer(const std::vector<uint8_t>& fileBuffer) {
-    std::cout << "Escaneando " << fileBuffer.size() << " bytes..." << std::endl;
-    std::vector<ScanResult> results;
-    size_t n = fileBuffer.size();
+static std::vector<Interval> mergeIntervals(std::vector<Interval> v) {
+    std::sort(v.begin(), v.end());
+    std::vector<Interval> out;
+    for (const auto& iv : v) {
+        if (!out.empty() && iv.first <= out.back().second) {
+            out.back().second = std::max(out.back().second, iv.second);
+        }
+        else {
+            out.push_back(iv);
+        }
+    }
+    return out;
+}
 
-    // 1. Encontra todos os candidatos
-    for (size_t off = 0; off <= n - 12; off += 4) { // Pula de 4 em 4 bytes
-        // Checagem rápida de plausibilidade
-        const uint8_t* data = fileBuffer.data() + off;
-        uint32_t ol = *reinterpret_cast<const uint32_t*>(data + 0);
-        uint32_t orf = *reinterpret_cast<const uint32_t*>(data + 4);
-        size_t rem = n - off;
+// Índice do intervalo (ordenado, disjunto) que contém 'x', ou -1.
+static long long findInterval(const std::vector<Interval>& v, size_t x) {
+    auto it = std::upper_bound(v.begin(), v.end(), Interval{ x, SIZE_MAX });
+    if (it == v.begin()) return -1;
+    --it;
+    return (x >= it->first && x < it->second) ? (long long)(it - v.begin()) : -1;
+}
 
-        if (8 <= ol && ol <= rem && 8 <= orf && orf <= rem && orf >= ol) {
-            // Se parece bom, faz a validação completa
-            DecompressValidationResult res = validateAndGetConsumedSize(fileBuffer, off);
+/**
+ * @brief Re-scan incremental: o mesmo resultado de scanContainer(newData),
+ * reaproveitando 'oldBlocks' (manifesto da versão descrita por 'oldMap').
+ */
+std::vector<ScanResult> rescanContainer(ByteView newData, const BlockHashMap& oldMap,
+    const std::vector<ScanResult>& oldBlocks, size_t maxBlock, RescanStats& stats) {
+    const size_t n = newData.size();
+    std::vector<MatchedSegment> segments = matchAgainstHashMap(newData, oldMap);
+    stats.segments = segments.size();
 
-            if (res.success && res.consumedBytes > 0) {
-                results.push_back({ off, res.consumedBytes, res.decompressedSize });
-            }
+    // 1. Regiões sujas: bytes fora de qualquer trecho igual, mais os pontos
+    //    de emenda onde o contexto muda (trecho que não continua o anterior,
+    //    início/fim de arquivo com deslocamento). Cada uma é expandida em
+    //    'maxBlock' para os dois lados: só candidatos dentro disso podem ler
+    //    bytes alterados ou ter sido suprimidos por um bloco alterado.
+    std::vector<Interval> dirty;
+    size_t cursor = 0;
+    for (size_t i = 0; i < segments.size(); i++) {
+        const MatchedSegment& seg = segments[i];
+        stats.unchangedBytes += seg.length;
+        // Trechos contíguos nos dois arquivos já vêm unidos, então entre
+        // dois trechos sempre há uma emenda (mesmo com zero bytes sujos).
+        bool sameContext = i == 0 && seg.newStart == 0 && seg.oldStart == 0;
+        if (!sameContext) {
+            dirty.push_back({ cursor, seg.newStart });
         }
+        cursor = seg.newStart + seg.length;
+    }
+    if (segments.empty() || cursor < n || segments.back().oldStart + segments.back().length != oldMap.fileSize) {
+        dirty.push_back({ cursor, n });
+    }
+    std::vector<Interval> regions;
+    for (const auto& d : dirty) {
+        regions.push_back({ d.first > maxBlock ? d.first - maxBlock : 0, std::min(n, d.second + maxBlock) });
     }
-    std::cout << "Encontrados " << results.size() << " candidatos..." << std::endl;
+    regions = mergeIntervals(regions);
 
-    // 2. Deduplicação
-    std::sort(results.begin(), results.end());
+    // 2. Blocos antigos contidos inteiros num trecho igual, já no espaço do arquivo novo.
+    std::vector<ScanResult> sortedOld = oldBlocks;
+    std::sort(sortedOld.begin(), sortedOld.end());
+    std::vector<ScanResult> mapped;
+    for (const auto& seg : segments) {
+        auto it = std::lower_bound(sortedOld.begin(), sortedOld.end(), ScanResult{ seg.oldStart, SIZE_MAX, 0 });
+        for (; it != sortedOld.end() && it->offset < seg.oldStart + seg.length; ++it) {
+            if (it->offset + it->consumedSize <= seg.oldStart + seg.length) {
+                mapped.push_back({ it->offset - seg.oldStart + seg.newStart, it->consumedSize, it->decompressedSize });
+            }
+        }
+    }
+    std::sort(mapped.begin(), mapped.end());
 
+    // 3. Valida as regiões e junta com os blocos reaproveitados. Se um bloco
+    //    reaproveitado acabar descartado (sobreposto por um bloco novo), o
+    //    que ele suprimia no scan antigo é desconhecido: a região cresce para
+    //    cobri-lo e o processo se repete.
+    std::vector<ScanResult> raw;
+    std::vector<Interval> scanned;
+    uint64_t candidates = 0;
     std::vector<ScanResult> finalResults;
-    std::vector<std::pair<size_t, size_t>> keptRanges;
-
-    for (const auto& r : results) {
-        size_t off = r.offset;
-        size_t end = r.offset + r.consumedSize;
-        bool overlaps = false;
+    while (true) {
+        stats.passes++;
+        // Um bloco reaproveitado que começa numa região será revalidado;
+        // o que ele cobre também precisa entrar, pelo mesmo motivo acima.
+        bool grown = true;
+        while (grown) {
+            grown = false;
+            for (const auto& m : mapped) {
+                long long r = findInterval(regions, m.offset);
+                if (r >= 0 && regions[(size_t)r].second < m.offset + m.consumedSize) {
+                    regions[(size_t)r].second = m.offset + m.consumedSize;
+                    grown = true;
+                }
+            }
+            if (grown) regions = mergeIntervals(regions);
+        }
 
-        for (const auto& k : keptRanges) {
-            // se (r não termina antes de k começar) E (r não começa depois de k terminar)
-            if (!(end <= k.first || off >= k.second)) {
-                overlaps = true;
-                break;
+        for (const auto& reg : regions) {
+            size_t from = reg.first;
+            for (const auto& sc : scanned) {
+                if (sc.second <= from || sc.first >= reg.second) continue;
+                if (sc.first > from) {
+                    scanRange(newData, from, sc.first, raw, candidates);
+                    stats.rescannedBytes += sc.first - from;
+                }
+                from = std::max(from, sc.second);
+            }
+            if (from < reg.second) {
+                scanRange(newData, from, reg.second, raw, candidates);
+                stats.rescannedBytes += reg.second - from;
             }
         }
+        scanned = regions;
 
-        if (!overlaps) {
-            keptRanges.push_back({ off, end });
-            finalResults.push_back(r);
+        std::vector<ScanResult> combined = raw;
+        std::vector<ScanResult> reused;
+        for (const auto& m : mapped) {
+            if (findInterval(regions, m.offset) < 0) reused.push_back(m);
         }
-    }
+        combined.insert(combined.end(), reused.begin(), reused.end());
+        finalResults = dedupScanResults(combined);
 
-    std::cout << "Scan concluído. Encontrados " << finalResults.size() << " blocos válidos." << std::endl;
+        std::vector<Interval> dropped;
+        for (const auto& m : reused) {
+            auto it = std::lower_bound(finalResults.begin(), finalResults.end(), m);
+            if (it == finalResults.end() || it->offset != m.offset || it->consumedSize != m.consumedSize) {
+                dropped.push_back({ m.offset, m.offset + m.consumedSize });
+            }
+        }
+        if (dropped.empty()) {
+            stats.reusedBlocks = reused.size();
+            break;
+        }
+        regions.insert(regions.end(), dropped.begin(), dropped.end());
+        regions = mergeIntervals(regions);
+    }
     return finalResults;
 }
 
-// --- Função de Processamento (lê, escaneia, extrai) ---
-
-bool processContainerFile(const std::string& inPath, const std::string& outDir) {
-    std::cout << "Processando arquivo: " << inPath << std::endl;
-    std::cout << "Salvando em: " << outDir << std::endl;
-
-    // 1. Criar diretório de saída
+/**
+ * @brief Carrega a versão antiga como mapa de hashes: lê um arquivo .twhm
+ * pronto ou calcula o mapa a partir do container antigo.
+ */
+bool loadOldHashMap(const std::string& path, uint32_t blockSize, BlockHashMap& map) {
     try {
-        std::filesystem::create_directories(outDir);
+        if (readBlockHashMap(path, map)) return true;
     }
     catch (const std::exception& e) {
-        std::cerr << "Erro: Nao foi possivel criar o diretorio de saida: " << e.what() << std::endl;
+        std::cerr << "Erro: " << e.what() << std::endl;
         return false;
     }
+    MappedFile oldData;
+    if (!loadInputFile(path, oldData)) return false;
+    map = buildBlockHashMap(oldData.view(), blockSize);
+    return true;
+}
 
-    // 2. Ler arquivo de entrada
-    std::ifstream inFile(inPath, std::ios::binary);
-    if (!inFile) {
-        std::cerr << "Erro: Nao foi possivel abrir o arquivo de entrada: " << inPath << std::endl;
+bool hashMapContainerFile(const std::string& inPath, const std::string& outPath, uint32_t blockSize) {
+    MappedFile inputData;
+    if (!loadInputFile(inPath, inputData)) return false;
+    BlockHashMap map = buildBlockHashMap(inputData.view(), blockSize);
+    if (!writeBlockHashMap(outPath, map)) {
+        std::cerr << "Erro: Nao foi possivel gravar o mapa de hashes: " << outPath << std::endl;
         return false;
     }
-    std::vector<uint8_t> inputData(
-        (std::istreambuf_iterator<char>(inFile)),
-        std::istreambuf_iterator<char>()
-    );
-    inFile.close();
-    if (inputData.empty()) {
-        std::cerr << "Erro: O arquivo de entrada esta vazio." << std::endl;
+    std::cout << "Mapa de hashes gravado em: " << outPath << " (" << map.weak.size()
+        << " blocos de " << blockSize << " bytes)" << std::endl;
+    return true;
+}
+
+bool rescanContainerFile(const std::string& oldPath, const std::string& oldManifestPath,
+    const std::string& newPath, const std::string& newManifestPath, ManifestFormat fmt,
+    uint32_t blockSize, size_t maxBlock) {
+    std::vector<ScanResult> oldBlocks;
+    try {
+        oldBlocks = readManifest(oldManifestPath);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Erro: " << e.what() << std::endl;
         return false;
     }
+    BlockHashMap oldMap;
+    if (!loadOldHashMap(oldPath, blockSize, oldMap)) return false;
 
-    // 3. Escanear por blocos LZSS
-    std::vector<ScanResult> blocks = scanContainer(inputData);
-    if (blocks.empty()) {
-        std::cout << "Nenhum bloco LZSS valido foi encontrado." << std::endl;
-        return true;
+    MappedFile newData;
+    if (!loadInputFile(newPath, newData)) return false;
+
+    if (maxBlock == 0) {
+        for (const auto& b : oldBlocks) maxBlock = std::max(maxBlock, b.consumedSize);
+        maxBlock = std::max<size_t>(maxBlock, 12);
     }
 
-    // 4. Extrair cada bloco
-    int n_ok = 0;
-    int n_err = 0;
-    for (const auto& blockInfo : blocks) {
-        try {
-            // Pega o bloco comprimido (raw) do buffer
-            size_t off = blockInfo.offset;
-            size_t end = off + blockInfo.consumedSize;
-            std::vector<uint8_t> rawBlock(inputData.begin() + off, inputData.begin() + end);
+    auto t0 = std::chrono::steady_clock::now();
+    RescanStats stats;
+    std::vector<ScanResult> blocks = rescanContainer(newData.view(), oldMap, oldBlocks, maxBlock, stats);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
 
-            // Descomprime usando a função de extração
-            std::vector<uint8_t> decompressedData = decompressLZSSBlock(rawBlock);
+    std::ofstream out(newManifestPath, std::ios::binary);
+    if (!out) {
+        std::cerr << "Erro: Nao foi possivel criar o manifesto: " << newManifestPath << std::endl;
+        return false;
+    }
+    writeManifest(out, blocks, fmt, newPath, newData.size());
+    out.close();
 
-            // Verifica se o tamanho bate (checagem de sanidade)
-            if (decompressedData.size() != blockInfo.decompressedSize) {
-                std::cerr << "Warning: Tamanho descomprimido (do scan) " << blockInfo.decompressedSize
-                    << " nao bate com (da extracao) " << decompressedData.size()
-                    << " no offset " << off << std::endl;
-            }
+    std::cout << "Re-scan incremental: " << stats.segments << " trechos iguais ("
+        << stats.unchangedBytes << " de " << newData.size() << " bytes), "
+        << stats.rescannedBytes << " bytes revalidados em " << stats.passes << " passada(s)." << std::endl;
+    std::cout << "Blocos: " << blocks.size() << " (" << stats.reusedBlocks << " reaproveitados), "
+        << std::fixed << std::setprecision(3) << secs << std::defaultfloat << "s. Manifesto gravado em: "
+        << newManifestPath << std::endl;
+    return (bool)out;
+}
+
+// --- Estágio de Escrita Assíncrona ---
+//
+// A extração não grava mais os arquivos no mesmo thread que descomprime:
+// cada chunk pronto vai para uma fila limitada e um estágio escritor
+// separado cuida de abrir/gravar/fechar. Assim decodificação e I/O se
+// sobrepõem. Os tempos que cada lado passa bloqueado na fila mostram se a
+// execução foi limitada por I/O (decodificação esperando) ou por CPU
+// (escritor esperando).
+
+struct WriteJob {
+    std::filesystem::path path;
+    std::vector<uint8_t> data;
+    ScanResult block{}; // Bloco de origem (usado pelo índice do pack)
+};
+
+struct WriterStats {
+    uint64_t files = 0;
+    uint64_t bytes = 0;
+    uint64_t failed = 0;
+    double producerWaitSec = 0; // Decodificação bloqueada com a fila cheia
+    double consumerWaitSec = 0; // Escritor(es) parado(s) com a fila vazia (soma dos threads)
+    double writeSec = 0;        // Só no modo síncrono: tempo gravando
+};
 
-            // Formata o nome do arquivo de saída
-            std::stringstream ss;
-            ss << "chunk_off_" << std::hex << std::setfill('0') << std::setw(8) << blockInfo.offset
-                << "_dec_" << std::dec << decompressedData.size() << ".bin";
-            std::filesystem::path outFilePath = std::filesystem::path(outDir) / ss.str();
+/**
+ * @brief Fila limitada por número de itens e por bytes, com medição do
+ * tempo que produtor e consumidores passam bloqueados.
+ */
+class BoundedJobQueue {
+public:
+    BoundedJobQueue(size_t maxItems, size_t maxBytes) : maxItems_(maxItems), maxBytes_(maxBytes) {}
 
-            // Salva o arquivo
-            std::ofstream outFile(outFilePath, std::ios::binary);
-            outFile.write(reinterpret_cast<const char*>(decompressedData.data()), decompressedData.size());
-            outFile.close();
-            n_ok++;
+    void push(WriteJob&& job) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        size_t sz = job.data.size();
+        auto full = [&] { return items_.size() >= maxItems_ || (!items_.empty() && bytes_ + sz > maxBytes_); };
+        if (full()) {
+            auto t0 = std::chrono::steady_clock::now();
+            notFull_.wait(lock, [&] { return !full(); });
+            producerWait_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        }
+        bytes_ += sz;
+        items_.push_back(std::move(job));
+        notEmpty_.notify_one();
+    }
 
+    // Pega até 'max' itens (espera pelo menos um). Retorna false quando a
+    // fila foi fechada e esvaziada.
+    bool popMany(std::vector<WriteJob>& out, size_t max) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (items_.empty() && !closed_) {
+            auto t0 = std::chrono::steady_clock::now();
+            notEmpty_.wait(lock, [&] { return !items_.empty() || closed_; });
+            consumerWait_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
         }
-        catch (const std::exception& e) {
-            std::cerr << "Erro ao extrair bloco no offset 0x" << std::hex << blockInfo.offset << ": " << e.what() << std::endl;
-            n_err++;
+        if (items_.empty()) return false;
+        while (!items_.empty() && out.size() < max) {
+            bytes_ -= items_.front().data.size();
+            out.push_back(std::move(items_.front()));
+            items_.pop_front();
         }
+        notFull_.notify_all();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        notEmpty_.notify_all();
     }
 
-    std::cout << "Extração concluída: " << n_ok << " OK, " << n_err << " Falhas." << std::endl;
+    double producerWait() const { return producerWait_; }
+    double consumerWait() const { return consumerWait_; }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable notFull_, notEmpty_;
+    std::deque<WriteJob> items_;
+    size_t maxItems_, maxBytes_;
+    size_t bytes_ = 0;
+    bool closed_ = false;
+    double producerWait_ = 0, consumerWait_ = 0;
+};
+
+/**
+ * @brief Grava 'data' em 'path' (cria/trunca) com uma única sequência
+ * open + pwrite + close. Preenche 'error' em caso de falha.
+ */
+bool writeWholeFile(const std::filesystem::path& path, const uint8_t* data, size_t size, std::string& error) {
+#ifdef _WIN32
+    HANDLE h = CreateFileW(path.wstring().c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (h == INVALID_HANDLE_VALUE) {
+        error = "CreateFile falhou (" + std::to_string(GetLastError()) + ")";
+        return false;
+    }
+    size_t done = 0;
+    while (done < size) {
+        DWORD chunk = (DWORD)std::min<size_t>(size - done, 1u << 30);
+        DWORD wrote = 0;
+        if (!WriteFile(h, data + done, chunk, &wrote, nullptr) || wrote == 0) {
+            error = "WriteFile falhou (" + std::to_string(GetLastError()) + ")";
+            CloseHandle(h);
+            return false;
+        }
+        done += wrote;
+    }
+    CloseHandle(h);
+    return true;
+#else
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        error = std::string("open: ") + std::strerror(errno);
+        return false;
+    }
+    size_t done = 0;
+    while (done < size) {
+        ssize_t wrote = pwrite(fd, data + done, std::min<size_t>(size - done, 1u << 30), (off_t)done);
+        if (wrote <= 0) {
+            if (wrote < 0 && errno == EINTR) continue;
+            error = std::string("pwrite: ") + std::strerror(errno);
+            ::close(fd);
+            return false;
+        }
+        done += (size_t)wrote;
+    }
+    if (::close(fd) != 0) {
+        error = std::string("close: ") + std::strerror(errno);
+        return false;
+    }
     return true;
+#endif
 }
 
+/**
+ * @brief Interface do estágio escritor.
+ */
+class OutputWriter {
+public:
+    virtual ~OutputWriter() = default;
+    // Entrega um chunk pronto. Pode bloquear se a fila estiver cheia.
+    // Pode ser chamado de vários threads (modo --batch).
+    virtual void submit(WriteJob&& job) = 0;
+    // Espera gravar tudo o que foi entregue e encerra os threads.
+    virtual WriterStats finish() = 0;
+    virtual const char* name() const = 0;
+
+protected:
+    void recordFailure(const WriteJob& job, const std::string& error) {
+        std::lock_guard<std::mutex> lock(errMutex_);
+        failed_++;
+        std::cerr << "Erro ao gravar " << job.path.string() << ": " << error << std::endl;
+    }
+    void recordSuccess(size_t bytes) {
+        files_.fetch_add(1, std::memory_order_relaxed);
+        bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+    WriterStats baseStats() const {
+        WriterStats st;
+        st.files = files_.load();
+        st.bytes = bytes_.load();
+        st.failed = failed_;
+        return st;
+    }
+
+private:
+    std::mutex errMutex_;
+    uint64_t failed_ = 0;
+    std::atomic<uint64_t> files_{ 0 }, bytes_{ 0 };
+};
 
 /**
- * @brief Função principal
+ * @brief Comportamento antigo: grava no próprio thread da decodificação.
  */
-int main(int argc, char* argv[]) {
+class SyncWriter : public OutputWriter {
+public:
+    void submit(WriteJob&& job) override {
+        TraceScope trace("write");
+        auto t0 = std::chrono::steady_clock::now();
+        std::string error;
+        if (writeWholeFile(job.path, job.data.data(), job.data.size(), error)) recordSuccess(job.data.size());
+        else recordFailure(job, error);
+        writeNs_.fetch_add((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - t0).count(), std::memory_order_relaxed);
+    }
+    WriterStats finish() override {
+        WriterStats st = baseStats();
+        st.writeSec = writeNs_.load() / 1e9;
+        return st;
+    }
+    const char* name() const override { return "sync"; }
 
-    // =========================================================
-    // MUDANÇA CRÍTICA: Forçar TUDO para UTF-8 (CP 65001)
-    // =========================================================
-#ifdef _WIN32
-    // Define o locale do C/C++ para UTF-8.
-    // Isso é importante para que o C++ (ex: fstream) 
-    // interprete corretamente os nomes de arquivo.
-    setlocale(LC_ALL, ".UTF8");
+private:
+    std::atomic<uint64_t> writeNs_{ 0 };
+};
 
-    // Define a página de código de SAÍDA do console para 65001 (UTF-8)
-    // Isso faz com que 'std::cout' exiba 'ç', 'á', 'ã' corretamente.
-    SetConsoleOutputCP(CP_UTF8); // CP_UTF8 é um atalho para 65001
+/**
+ * @brief Pool de threads consumindo a fila, cada um com open/pwrite/close.
+ */
+class ThreadPoolWriter : public OutputWriter {
+public:
+    ThreadPoolWriter(unsigned threads, size_t queueItems, size_t queueBytes) : queue_(queueItems, queueBytes) {
+        threads = std::max(1u, threads);
+        for (unsigned i = 0; i < threads; i++) {
+            workers_.emplace_back([this, i] {
+                traceThreadName("writer " + std::to_string(i));
+                loop();
+            });
+        }
+    }
+    ~ThreadPoolWriter() override { finish(); }
 
-    // Define a página de código de ENTRADA do console para 65001 (UTF-8)
-    // Isso afeta 'std::cin' e 'std::getline'.
-    SetConsoleCP(CP_UTF8);
-#endif
-    // =========================================================
-    // FIM DA MUDANÇA
-    // =========================================================
+    void submit(WriteJob&& job) override { queue_.push(std::move(job)); }
+
+    WriterStats finish() override {
+        if (!finished_) {
+            queue_.close();
+            for (auto& t : workers_) t.join();
+            finished_ = true;
+        }
+        WriterStats st = baseStats();
+        st.producerWaitSec = queue_.producerWait();
+        st.consumerWaitSec = queue_.consumerWait();
+        return st;
+    }
+    const char* name() const override { return "threads"; }
 
+private:
+    void loop() {
+        std::vector<WriteJob> batch;
+        while (queue_.popMany(batch, 1)) {
+            for (auto& job : batch) {
+                TraceScope trace("write");
+                std::string error;
+                if (writeWholeFile(job.path, job.data.data(), job.data.size(), error)) recordSuccess(job.data.size());
+                else recordFailure(job, error);
+            }
+            batch.clear();
+        }
+    }
+
+    BoundedJobQueue queue_;
+    std::vector<std::thread> workers_;
+    bool finished_ = false;
+};
+
+#ifdef TWOH_HAVE_IO_URING
+/**
+ * @brief Anel io_uring mínimo (io_uring_setup/io_uring_enter direto via
+ * syscall, sem depender da liburing).
+ */
+class IoUringRing {
+public:
+    ~IoUringRing() { close(); }
+
+    void close() {
+        if (sqes_) munmap(sqes_, sqesSize_);
+        if (cqRing_ && cqRing_ != sqRing_) munmap(cqRing_, cqRingSize_);
+        if (sqRing_) munmap(sqRing_, sqRingSize_);
+        if (fd_ >= 0) ::close(fd_);
+        sqes_ = nullptr;
+        cqRing_ = sqRing_ = nullptr;
+        fd_ = -1;
+    }
+
+    bool init(unsigned entries) {
+        io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        fd_ = (int)syscall(__NR_io_uring_setup, entries, &p);
+        if (fd_ < 0) return false;
+
+        sqRingSize_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cqRingSize_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+
+        sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+        if (sqRing_ == MAP_FAILED) { sqRing_ = nullptr; return false; }
+        cqRing_ = single ? sqRing_ : mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED) { cqRing_ = nullptr; return false; }
+        sqesSize_ = p.sq_entries * sizeof(io_uring_sqe);
+        void* sq = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+        if (sq == MAP_FAILED) return false;
+        sqes_ = static_cast<io_uring_sqe*>(sq);
+
+        char* s = static_cast<char*>(sqRing_);
+        sqHead_ = reinterpret_cast<unsigned*>(s + p.sq_off.head);
+        sqTail_ = reinterpret_cast<unsigned*>(s + p.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned*>(s + p.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned*>(s + p.sq_off.array);
+        sqEntries_ = p.sq_entries;
+        char* c = static_cast<char*>(cqRing_);
+        cqHead_ = reinterpret_cast<unsigned*>(c + p.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(c + p.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned*>(c + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(c + p.cq_off.cqes);
+        localTail_ = submitted_ = reaped_ = *sqTail_;
+        return supportsOps();
+    }
+
+    unsigned capacity() const { return sqEntries_; }
+
+    io_uring_sqe* next() {
+        unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        if (localTail_ - head >= sqEntries_) return nullptr;
+        unsigned idx = localTail_ & sqMask_;
+        sqArray_[idx] = idx;
+        localTail_++;
+        io_uring_sqe* sqe = &sqes_[idx];
+        std::memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    // Publica as SQEs preparadas e espera 'waitNr' conclusões. O kernel pode
+    // consumir só parte das SQEs numa chamada (e aí não espera): repete até
+    // todas terem sido entregues.
+    bool submitAndWait(unsigned waitNr) {
+        __atomic_store_n(sqTail_, localTail_, __ATOMIC_RELEASE);
+        for (;;) {
+            unsigned toSubmit = localTail_ - submitted_;
+            if (toSubmit == 0 && waitNr == 0) return true;
+            int r = (int)syscall(__NR_io_uring_enter, fd_, toSubmit, waitNr, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (r < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            submitted_ += (unsigned)r;
+            if ((unsigned)r >= toSubmit) return true;
+            if (r == 0) return false; // Nada consumido: não adianta insistir
+        }
+    }
+
+    bool pop(io_uring_cqe& out) {
+        unsigned head = *cqHead_;
+        if (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) return false;
+        out = cqes_[head & cqMask_];
+        __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+        reaped_++;
+        return true;
+    }
+
+    // SQEs entregues ao kernel cuja conclusão ainda não foi lida.
+    unsigned inFlight() const { return submitted_ - reaped_; }
+
+    // Depois de uma falha: as SQEs publicadas que o kernel não consumiu são
+    // retiradas do anel (sem SQPOLL ele só as lê dentro do io_uring_enter),
+    // e todas as que ele consumiu são esperadas até concluírem. Com isso
+    // nenhuma operação fica apontando para o lote e nenhuma conclusão velha
+    // sobra para o próximo. false se nem isso deu certo.
+    template <typename F>
+    bool drain(F onCqe) {
+        localTail_ = submitted_;
+        __atomic_store_n(sqTail_, localTail_, __ATOMIC_RELEASE);
+        io_uring_cqe cqe;
+        while (inFlight() > 0) {
+            if (pop(cqe)) {
+                onCqe(cqe);
+                continue;
+            }
+            int r = (int)syscall(__NR_io_uring_enter, fd_, 0, inFlight(), IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (r < 0 && errno != EINTR) return false;
+        }
+        return true;
+    }
+
+private:
+    // Kernels antigos têm io_uring mas não OPENAT/CLOSE (5.6+).
+    bool supportsOps() {
+        const unsigned nOps = 64;
+        std::vector<uint8_t> buf(sizeof(io_uring_probe) + nOps * sizeof(io_uring_probe_op), 0);
+        io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(buf.data());
+        if (syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, probe, nOps) < 0) return false;
+        for (unsigned op : { (unsigned)IORING_OP_OPENAT, (unsigned)IORING_OP_WRITE, (unsigned)IORING_OP_CLOSE }) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+        }
+        return true;
+    }
+
+    int fd_ = -1;
+    void* sqRing_ = nullptr;
+    void* cqRing_ = nullptr;
+    size_t sqRingSize_ = 0, cqRingSize_ = 0, sqesSize_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    io_uring_cqe* cqes_ = nullptr;
+    unsigned *sqHead_ = nullptr, *sqTail_ = nullptr, *sqArray_ = nullptr;
+    unsigned *cqHead_ = nullptr, *cqTail_ = nullptr;
+    unsigned sqMask_ = 0, cqMask_ = 0, sqEntries_ = 0;
+    unsigned localTail_ = 0; // SQEs preparadas (next)
+    unsigned submitted_ = 0; // SQEs já consumidas pelo io_uring_enter
+    unsigned reaped_ = 0;    // Conclusões já lidas (pop)
+};
+
+/**
+ * @brief Escritor io_uring: um thread pega lotes da fila e submete todos os
+ * open de uma vez, depois todos os pares write+close encadeados
+ * (IOSQE_IO_LINK) de uma vez: duas chamadas ao kernel por lote em vez de
+ * três syscalls por arquivo. Se o anel falhar e não puder ser esvaziado,
+ * ele é fechado e o resto da execução grava pelo caminho síncrono.
+ */
+class IoUringWriter : public OutputWriter {
+public:
+    IoUringWriter(size_t queueItems, size_t queueBytes) : queue_(queueItems, queueBytes) {}
+    ~IoUringWriter() override { finish(); }
+
+    bool start() {
+        if (!ring_.init(2 * kBatch)) return false;
+        worker_ = std::thread([this] { loop(); });
+        return true;
+    }
+
+    void submit(WriteJob&& job) override { queue_.push(std::move(job)); }
+
+    WriterStats finish() override {
+        if (worker_.joinable()) {
+            queue_.close();
+            worker_.join();
+        }
+        WriterStats st = baseStats();
+        st.producerWaitSec = queue_.producerWait();
+        st.consumerWaitSec = queue_.consumerWait();
+        return st;
+    }
+    const char* name() const override { return "io_uring"; }
+
+private:
+    static const unsigned kBatch = 32;
+
+    void loop() {
+        std::vector<WriteJob> batch;
+        traceThreadName("writer io_uring");
+        while (queue_.popMany(batch, kBatch)) {
+            TraceScope trace("write_batch");
+            trace.arg("files", batch.size());
+            writeBatch(batch);
+            batch.clear();
+        }
+    }
+
+    // Se algo der errado no anel, o arquivo é gravado pelo caminho síncrono.
+    void fallback(const WriteJob& job) {
+        std::string error;
+        if (writeWholeFile(job.path, job.data.data(), job.data.size(), error)) recordSuccess(job.data.size());
+        else recordFailure(job, error);
+    }
+
+    void writeBatch(std::vector<WriteJob>& batch) {
+        const size_t n = batch.size();
+        if (broken_) {
+            for (auto& job : batch) fallback(job);
+            return;
+        }
+        std::vector<int> fds(n, -1);
+
+        // 1. Todos os open do lote.
+        unsigned queued = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (batch[i].data.size() >= (1u << 31)) continue; // Grande demais para um write único
+            io_uring_sqe* sqe = ring_.next();
+            if (!sqe) break;
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = (uint64_t)(uintptr_t)batch[i].path.c_str();
+            sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+            sqe->len = 0644;
+            sqe->user_data = i;
+            queued++;
+        }
+        auto onOpen = [&](const io_uring_cqe& cqe) {
+            if (cqe.res >= 0) fds[cqe.user_data] = cqe.res;
+        };
+        if (queued && !reap(queued, onOpen)) {
+            if (!ring_.drain(onOpen)) {
+                abandon(batch);
+                return;
+            }
+            for (int fd : fds) if (fd >= 0) ::close(fd);
+            for (auto& job : batch) fallback(job);
+            return;
+        }
+
+        // 2. write + close encadeados para cada arquivo aberto.
+        std::vector<int> written(n, INT32_MIN), closed(n, INT32_MIN);
+        std::vector<bool> closeQueued(n, false);
+        queued = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (fds[i] < 0) continue;
+            io_uring_sqe* w = ring_.next();
+            if (!w) break;
+            io_uring_sqe* c = ring_.next();
+            if (!c) {
+                // Sem espaço para o close: o write vira NOP e o arquivo vai
+                // pelo caminho síncrono.
+                w->opcode = IORING_OP_NOP;
+                w->user_data = 2 * i;
+                queued++;
+                break;
+            }
+            w->opcode = IORING_OP_WRITE;
+            w->fd = fds[i];
+            w->addr = (uint64_t)(uintptr_t)batch[i].data.data();
+            w->len = (uint32_t)batch[i].data.size();
+            w->off = 0;
+            w->flags = IOSQE_IO_LINK;
+            w->user_data = 2 * i;
+            c->opcode = IORING_OP_CLOSE;
+            c->fd = fds[i];
+            c->user_data = 2 * i + 1;
+            closeQueued[i] = true;
+            queued += 2;
+        }
+        auto onWrite = [&](const io_uring_cqe& cqe) {
+            size_t i = (size_t)(cqe.user_data / 2);
+            ((cqe.user_data & 1) ? closed : written)[i] = cqe.res;
+        };
+        if (queued && !reap(queued, onWrite)) {
+            // Um close que nunca foi submetido foi retirado do anel pelo
+            // drain e volta a valer como "não enfileirado".
+            if (!ring_.drain(onWrite)) {
+                abandon(batch);
+                return;
+            }
+            for (size_t i = 0; i < n; i++) {
+                if (closeQueued[i] && closed[i] == INT32_MIN) closeQueued[i] = false;
+            }
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            const WriteJob& job = batch[i];
+            if (fds[i] < 0) {
+                fallback(job);
+                continue;
+            }
+            if (written[i] == (int)job.data.size() && closed[i] == 0) {
+                recordSuccess(job.data.size());
+                continue;
+            }
+            // Escrita curta ou corrente cancelada: completa de forma síncrona.
+            // Todas as conclusões já chegaram, então o fd só continua aberto
+            // se o close nem foi enfileirado ou foi cancelado; com outro
+            // resultado o kernel já o liberou (e o número pode estar em uso).
+            if (!closeQueued[i] || closed[i] == -ECANCELED) ::close(fds[i]);
+            fallback(job);
+        }
+    }
+
+    // O anel falhou com operações pendentes: o estado de cada arquivo do
+    // lote é desconhecido, então nenhum fd é fechado e nada é regravado (um
+    // open atrasado truncaria o arquivo de novo). Os buffers ficam vivos até
+    // o fim do escritor e o anel é fechado.
+    void abandon(std::vector<WriteJob>& batch) {
+        std::cerr << "Aviso: io_uring falhou com operacoes pendentes; gravando o resto de forma sincrona." << std::endl;
+        for (const auto& job : batch) recordFailure(job, "estado desconhecido apos falha do io_uring");
+        abandoned_.push_back(std::move(batch));
+        batch.clear();
+        ring_.close();
+        broken_ = true;
+    }
+
+    template <typename F>
+    bool reap(unsigned expected, F onCqe) {
+        if (!ring_.submitAndWait(expected)) return false;
+        unsigned got = 0;
+        io_uring_cqe cqe;
+        while (got < expected) {
+            if (ring_.pop(cqe)) {
+                onCqe(cqe);
+                got++;
+            }
+            else if (!ring_.submitAndWait(expected - got)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::vector<std::vector<WriteJob>> abandoned_; // Lotes de um anel que falhou (ver abandon)
+    bool broken_ = false;
+    IoUringRing ring_;
+    BoundedJobQueue queue_;
+    std::thread worker_;
+};
+#endif
+
+/**
+ * @brief Cria o escritor pedido. 'auto' (e 'uring' quando indisponível)
+ * usa io_uring se o kernel permitir e senão o pool de threads.
+ */
+std::unique_ptr<OutputWriter> makeOutputWriter(const WriterOptions& wo) {
+    if (wo.backend == WriterBackend::Sync) {
+        return std::make_unique<SyncWriter>();
+    }
+#ifdef TWOH_HAVE_IO_URING
+    if (wo.backend == WriterBackend::Auto || wo.backend == WriterBackend::IoUring) {
+        auto w = std::make_unique<IoUringWriter>(wo.queueItems, wo.queueBytes);
+        if (w->start()) return w;
+        if (wo.backend == WriterBackend::IoUring) {
+            std::cerr << "Aviso: io_uring indisponivel; usando pool de threads." << std::endl;
+        }
+    }
+#endif
+    return std::make_unique<ThreadPoolWriter>(wo.threads, wo.queueItems, wo.queueBytes);
+}
+
+void printWriterStats(const OutputWriter& writer, const WriterStats& st) {
+    std::ostream& log = logStream();
+    log << std::fixed << std::setprecision(2) << "Escrita (" << writer.name() << "): " << st.files << " arquivos, "
+        << st.bytes / (1024.0 * 1024.0) << " MB";
+    if (st.failed) log << ", " << st.failed << " falhas";
+    if (st.writeSec > 0) {
+        log << "; " << st.writeSec << "s gravando no thread de decodificacao";
+    }
+    else {
+        log << "; decodificacao esperou " << st.producerWaitSec << "s pela escrita, escrita esperou "
+            << st.consumerWaitSec << "s pela decodificacao";
+        if (st.producerWaitSec > st.consumerWaitSec) log << " (limitado por I/O)";
+        else log << " (limitado por CPU)";
+    }
+    log << std::defaultfloat << std::endl;
+}
+
+// --- Nomes dos Chunks Extraídos ---
+
+/**
+ * @brief Nome do arquivo de saída de um bloco: chunk_off_XXXXXXXX_dec_N.bin
+ */
+std::string chunkFileName(uint64_t offset, size_t decompressedSize) {
+    std::stringstream ss;
+    ss << "chunk_off_" << std::hex << std::setfill('0') << std::setw(8) << offset
+        << "_dec_" << std::dec << decompressedSize << ".bin";
+    return ss.str();
+}
+
+// --- Pack: Saída num Arquivo Único com Índice ---
+//
+// Com dezenas de milhares de chunks, criar um arquivo por chunk custa mais
+// em metadados (rede, ext4) do que a própria descompressão. O modo --pack
+// grava todos os chunks em sequência num único arquivo, seguido de um
+// índice. Layout (little-endian):
+//
+//   "TWPK" u32 versão u64 reservado          (cabeçalho, 16 bytes)
+//   dados dos chunks, um após o outro
+//   índice: contagem * { u64 offset no container, u64 offset no pack,
+//           u64 tamanho descomprimido, u32 tamanho comprimido,
+//           u32 reservado, u64 XXH64 dos dados }  (40 bytes, ordenado por offset no container)
+//   u64 offset do índice, u64 contagem, "TWPK", u32 versão   (rodapé, 24 bytes)
+
+static const char kPackMagic[4] = { 'T', 'W', 'P', 'K' };
+static const uint32_t kPackVersion = 1;
+static const size_t kPackHeaderSize = 16;
+static const size_t kPackEntrySize = 40;
+static const size_t kPackFooterSize = 24;
+
+struct PackEntry {
+    uint64_t sourceOffset;
+    uint64_t packOffset;
+    uint64_t decompressedSize;
+    uint32_t compressedSize;
+    uint64_t hash;
+};
+
+/**
+ * @brief Escritor que anexa os chunks num pack, num thread próprio (a
+ * decodificação continua sobreposta à escrita, como nos outros escritores).
+ */
+class PackWriter : public OutputWriter {
+public:
+    PackWriter(const std::string& path, size_t queueItems, size_t queueBytes)
+        : path_(path), queue_(queueItems, queueBytes) {}
+    ~PackWriter() override { finish(); }
+
+    bool start() {
+        out_.rdbuf()->pubsetbuf(buffer_, sizeof(buffer_));
+        out_.open(std::filesystem::path(path_), std::ios::binary | std::ios::trunc);
+        if (!out_) return false;
+        out_.write(kPackMagic, sizeof(kPackMagic));
+        writeLE<uint32_t>(out_, kPackVersion);
+        writeLE<uint64_t>(out_, 0);
+        if (!out_) return false;
+        pos_ = kPackHeaderSize;
+        worker_ = std::thread([this] { loop(); });
+        return true;
+    }
+
+    void submit(WriteJob&& job) override { queue_.push(std::move(job)); }
+
+    WriterStats finish() override {
+        if (worker_.joinable()) {
+            queue_.close();
+            worker_.join();
+            if (!writeIndex()) {
+                // Sem índice o pack inteiro é ilegível: conta como falha.
+                WriteJob pack;
+                pack.path = path_;
+                recordFailure(pack, "falha ao gravar o indice do pack");
+            }
+        }
+        WriterStats st = baseStats();
+        st.producerWaitSec = queue_.producerWait();
+        st.consumerWaitSec = queue_.consumerWait();
+        return st;
+    }
+    const char* name() const override { return "pack"; }
+
+private:
+    void loop() {
+        std::vector<WriteJob> batch;
+        traceThreadName("writer pack");
+        while (queue_.popMany(batch, 64)) {
+            TraceScope trace("pack_append");
+            trace.arg("chunks", batch.size());
+            for (auto& job : batch) {
+                if (!out_) {
+                    recordFailure(job, "falha de escrita no pack");
+                    continue;
+                }
+                out_.write(reinterpret_cast<const char*>(job.data.data()), job.data.size());
+                if (!out_) {
+                    recordFailure(job, "falha de escrita no pack");
+                    continue;
+                }
+                index_.push_back({ job.block.offset, pos_, job.data.size(), (uint32_t)job.block.consumedSize,
+                    XXH64::hash(job.data.data(), job.data.size()) });
+                pos_ += job.data.size();
+                recordSuccess(job.data.size());
+            }
+            batch.clear();
+        }
+    }
+
+    // Índice e rodapé; false se algo não chegou ao disco.
+    bool writeIndex() {
+        std::sort(index_.begin(), index_.end(),
+            [](const PackEntry& a, const PackEntry& b) { return a.sourceOffset < b.sourceOffset; });
+        uint64_t indexOffset = pos_;
+        for (const auto& e : index_) {
+            writeLE<uint64_t>(out_, e.sourceOffset);
+            writeLE<uint64_t>(out_, e.packOffset);
+            writeLE<uint64_t>(out_, e.decompressedSize);
+            writeLE<uint32_t>(out_, e.compressedSize);
+            writeLE<uint32_t>(out_, 0);
+            writeLE<uint64_t>(out_, e.hash);
+        }
+        writeLE<uint64_t>(out_, indexOffset);
+        writeLE<uint64_t>(out_, index_.size());
+        out_.write(kPackMagic, sizeof(kPackMagic));
+        writeLE<uint32_t>(out_, kPackVersion);
+        out_.close();
+        return (bool)out_;
+    }
+
+    std::string path_;
+    BoundedJobQueue queue_;
+    std::thread worker_;
+    std::ofstream out_;
+    char buffer_[1 << 20];
+    uint64_t pos_ = 0;
+    std::vector<PackEntry> index_;
+};
+
+static uint64_t loadLE64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) v |= (uint64_t)p[i] << (8 * i);
+    return v;
+}
+
+static uint32_t loadLE32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief Leitura de um pack: mapeia o arquivo e localiza chunks por busca
+ * binária direto no índice mapeado (find). data() devolve uma visão para
+ * dentro do mapeamento, sem cópia.
+ *
+ * O índice inteiro é conferido na abertura (cada chunk dentro da área de
+ * dados, índice ordenado), então entry()/data() nunca apontam para fora do
+ * arquivo, mesmo com um pack truncado ou corrompido.
+ */
+class PackReader {
+public:
+    bool open(const std::string& path) {
+        count_ = 0;
+        index_ = nullptr;
+        if (!file_.open(path) || file_.size() < kPackHeaderSize + kPackFooterSize) return false;
+        const uint8_t* base = file_.data();
+        const uint8_t* footer = base + file_.size() - kPackFooterSize;
+        if (!std::equal(base, base + 4, kPackMagic) || !std::equal(footer + 16, footer + 20, kPackMagic) ||
+            loadLE32(footer + 20) != kPackVersion) {
+            return false;
+        }
+        const uint64_t indexOffset = loadLE64(footer);
+        const uint64_t count = loadLE64(footer + 8);
+        const uint64_t indexEnd = file_.size() - kPackFooterSize;
+        if (indexOffset < kPackHeaderSize || indexOffset > indexEnd) return false;
+        // Divide antes de multiplicar: uma contagem absurda não pode dar a volta.
+        if (count > (indexEnd - indexOffset) / kPackEntrySize || indexOffset + count * kPackEntrySize != indexEnd) {
+            return false;
+        }
+        index_ = base + indexOffset;
+        count_ = (size_t)count;
+        for (size_t i = 0; i < count_; i++) {
+            PackEntry e = entry(i);
+            bool inData = e.packOffset >= kPackHeaderSize && e.decompressedSize <= indexOffset
+                && e.packOffset <= indexOffset - e.decompressedSize;
+            bool sorted = i == 0 || loadLE64(index_ + (i - 1) * kPackEntrySize) <= e.sourceOffset;
+            if (!inData || !sorted) {
+                count_ = 0;
+                index_ = nullptr;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t size() const { return count_; }
+
+    PackEntry entry(size_t i) const {
+        const uint8_t* p = index_ + i * kPackEntrySize;
+        return { loadLE64(p), loadLE64(p + 8), loadLE64(p + 16), loadLE32(p + 24), loadLE64(p + 32) };
+    }
+
+    ByteView data(const PackEntry& e) const {
+        return ByteView(file_.data() + e.packOffset, (size_t)e.decompressedSize);
+    }
+
+    // Procura o chunk que veio do offset 'sourceOffset' do container.
+    bool find(uint64_t sourceOffset, PackEntry& out) const {
+        size_t lo = 0, hi = count_;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (loadLE64(index_ + mid * kPackEntrySize) < sourceOffset) lo = mid + 1;
+            else hi = mid;
+        }
+        if (lo == count_) return false;
+        out = entry(lo);
+        return out.sourceOffset == sourceOffset;
+    }
+
+private:
+    MappedFile file_;
+    const uint8_t* index_ = nullptr;
+    size_t count_ = 0;
+};
+
+/**
+ * @brief Modo --unpack: transforma um pack de volta em arquivos
+ * chunk_off_*.bin, conferindo o hash de cada chunk.
+ */
+bool unpackFile(const std::string& packPath, const std::string& outDir, const WriterOptions& wo) {
+    PackReader pack;
+    if (!pack.open(packPath)) {
+        std::cerr << "Erro: Pack invalido ou ilegivel: " << packPath << std::endl;
+        return false;
+    }
+    try {
+        std::filesystem::create_directories(outDir);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Erro: Nao foi possivel criar o diretorio de saida: " << e.what() << std::endl;
+        return false;
+    }
+
+    std::unique_ptr<OutputWriter> writer = makeOutputWriter(wo);
+    size_t corrupt = 0;
+    for (size_t i = 0; i < pack.size() && !cancelRequested(); i++) {
+        PackEntry e = pack.entry(i);
+        ByteView data = pack.data(e);
+        if (XXH64::hash(data.data(), data.size()) != e.hash) {
+            std::cerr << "Erro: hash nao confere para o chunk do offset 0x" << std::hex << e.sourceOffset
+                << std::dec << std::endl;
+            corrupt++;
+            continue;
+        }
+        WriteJob job;
+        job.path = std::filesystem::path(outDir) / chunkFileName(e.sourceOffset, data.size());
+        job.data.assign(data.begin(), data.end());
+        writer->submit(std::move(job));
+    }
+    WriterStats st = writer->finish();
+    printWriterStats(*writer, st);
+    std::cout << "Unpack concluido: " << st.files << " arquivos, " << (st.failed + corrupt) << " falhas." << std::endl;
+    return st.failed == 0 && corrupt == 0;
+}
+
+// --- Índice de Saída (pula chunks inalterados) ---
+//
+// Reextrair para um diretório já populado regravaria todos os arquivos,
+// gastando escrita e mudando o mtime de quem não mudou. O diretório guarda
+// um índice (kOutputIndexName) com tamanho, mtime e XXH64 de cada chunk
+// gravado. Na extração seguinte, o hash calculado durante a descompressão
+// é comparado com o registrado: se bate e o arquivo não foi mexido desde
+// então (mesmo tamanho e mtime), ele não é regravado. Sem registro (ou se
+// o arquivo foi tocado), um arquivo de mesmo tamanho é lido e hasheado;
+// ler ainda custa menos que gravar e não altera o mtime.
+//
+// Layout (little-endian): "TWOI" u32 versão u32 contagem, depois
+// contagem * { u64 XXH64, u64 tamanho, i64 mtime, u16 tamanho do nome, nome }.
+
+constexpr char kOutputIndexMagic[4] = { 'T', 'W', 'O', 'I' };
+constexpr uint32_t kOutputIndexVersion = 1;
+const char* const kOutputIndexName = ".twoh_index";
+
+struct OutputRecord {
+    uint64_t hash = 0;
+    uint64_t size = 0;
+    int64_t mtime = 0;
+};
+
+static int64_t fileMtime(const std::filesystem::path& path, std::error_code& ec) {
+    return (int64_t)std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+}
+
+class OutputIndex {
+public:
+    uint64_t skipped = 0;
+    uint64_t savedBytes = 0;
+
+    OutputIndex(const std::string& dir, bool skipUnchanged) : dir_(dir), skip_(skipUnchanged) {}
+
+    // Índice ausente ou inválido = diretório sem registros (tudo é comparado pelo conteúdo).
+    void load() {
+        std::ifstream in(dir_ / kOutputIndexName, std::ios::binary);
+        char magic[4];
+        uint32_t version = 0, count = 0;
+        if (!in.read(magic, 4) || std::memcmp(magic, kOutputIndexMagic, 4) != 0) return;
+        if (!readLE(in, version) || version != kOutputIndexVersion || !readLE(in, count)) return;
+        for (uint32_t i = 0; i < count; i++) {
+            OutputRecord r;
+            uint16_t len = 0;
+            if (!readLE(in, r.hash) || !readLE(in, r.size) || !readLE(in, r.mtime) || !readLE(in, len)) break;
+            std::string name(len, '\0');
+            if (!in.read(&name[0], len)) break;
+            old_[name] = r;
+        }
+    }
+
+    /**
+     * @brief Registra o chunk desta extração e diz se o arquivo no disco já
+     * tem exatamente esse conteúdo (e portanto não precisa ser gravado).
+     */
+    bool unchanged(const std::string& name, uint64_t hash, uint64_t size) {
+        OutputRecord rec;
+        rec.hash = hash;
+        rec.size = size;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            current_.emplace_back(name, rec);
+        }
+        if (!skip_) return false;
+
+        std::filesystem::path path = dir_ / name;
+        std::error_code ec;
+        uint64_t onDisk = std::filesystem::file_size(path, ec);
+        if (ec || onDisk != size) return false;
+
+        bool same;
+        auto it = old_.find(name);
+        int64_t mtime = fileMtime(path, ec);
+        if (it != old_.end() && !ec && it->second.size == size && it->second.mtime == mtime) {
+            same = it->second.hash == hash;
+        }
+        else if (size == 0) {
+            same = true;
+        }
+        else {
+            MappedFile existing;
+            same = existing.open(path.string()) && existing.size() == size
+                && XXH64::hash(existing.data(), existing.size()) == hash;
+        }
+        if (same) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            skipped++;
+            savedBytes += size;
+        }
+        return same;
+    }
+
+    /**
+     * @brief Grava o índice com os chunks desta extração. Chamado depois que
+     * o escritor terminou, para pegar o mtime final de cada arquivo; chunks
+     * cuja gravação falhou (tamanho diferente no disco) ficam de fora.
+     */
+    bool save() {
+        std::vector<std::pair<std::string, OutputRecord>> keep;
+        keep.reserve(current_.size());
+        for (auto& entry : current_) {
+            std::filesystem::path path = dir_ / entry.first;
+            std::error_code ec;
+            uint64_t onDisk = std::filesystem::file_size(path, ec);
+            if (ec || onDisk != entry.second.size) continue;
+            entry.second.mtime = fileMtime(path, ec);
+            if (ec) continue;
+            keep.push_back(std::move(entry));
+        }
+
+        std::filesystem::path tmpPath = dir_ / (std::string(kOutputIndexName) + ".tmp");
+        {
+            std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+            if (!out) return false;
+            out.write(kOutputIndexMagic, 4);
+            writeLE<uint32_t>(out, kOutputIndexVersion);
+            writeLE<uint32_t>(out, (uint32_t)keep.size());
+            for (const auto& entry : keep) {
+                writeLE<uint64_t>(out, entry.second.hash);
+                writeLE<uint64_t>(out, entry.second.size);
+                writeLE<int64_t>(out, entry.second.mtime);
+                writeLE<uint16_t>(out, (uint16_t)entry.first.size());
+                out.write(entry.first.data(), entry.first.size());
+            }
+            if (!out) return false;
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmpPath, dir_ / kOutputIndexName, ec);
+        return !ec;
+    }
+
+private:
+    std::filesystem::path dir_;
+    bool skip_;
+    std::mutex mutex_; // unchanged() é chamado pelos workers do --batch
+    std::unordered_map<std::string, OutputRecord> old_;
+    std::vector<std::pair<std::string, OutputRecord>> current_;
+};
+
+// --- Função de Processamento (lê, escaneia, extrai) ---
+
+/**
+ * @brief Escritor da extração: o pack quando --pack foi pedido (e então
+ * 'outPath' é o arquivo do pack), senão o escritor de arquivos soltos.
+ */
+std::unique_ptr<OutputWriter> makeExtractionWriter(const std::string& outPath, const ProcessOptions& opts) {
+    if (opts.packOutput) {
+        auto pack = std::make_unique<PackWriter>(outPath, opts.writer.queueItems, opts.writer.queueBytes);
+        if (!pack->start()) {
+            std::cerr << "Erro: Nao foi possivel criar o pack: " << outPath << std::endl;
+            return nullptr;
+        }
+        return pack;
+    }
+    return makeOutputWriter(opts.writer);
+}
+
+// --- Armazenamento por Conteúdo (modo --dedup) ---
+//
+// Os containers repetem o mesmo asset (fontes, texturas comuns) em vários
+// offsets. Com --dedup cada conteúdo descomprimido é gravado uma única vez
+// em <saida>/.store/<xxh64>_<tamanho>.bin e os nomes por offset viram
+// hardlinks para ele (ou cópias, se o sistema de arquivos não suportar).
+//
+// Repetições são detectadas antes de descomprimir pelo XXH64 dos bytes
+// comprimidos: o mesmo bloco comprimido sempre gera a mesma saída, então
+// ele é decodificado uma vez só. Blocos comprimidos diferentes com a mesma
+// saída ainda são unidos depois, pelo hash calculado na descompressão.
+// Um arquivo da store já presente com o tamanho certo não é regravado
+// (o nome é o próprio conteúdo), e um nome por offset que já é link para
+// o arquivo certo fica como está.
+
+const char* const kStoreDirName = ".store";
+
+struct StoreKey {
+    uint64_t hash = 0;
+    uint64_t size = 0;
+};
+
+class ChunkStore {
+public:
+    uint64_t blocks = 0;       // blocos vistos
+    uint64_t rawRepeats = 0;   // repetidos pelo hash comprimido (não descomprimidos)
+    uint64_t contentRepeats = 0; // comprimidos diferentes, mesma saída
+    uint64_t savedBytes = 0;   // bytes não gravados graças à dedup
+
+    explicit ChunkStore(const std::string& outDir) : outDir_(outDir), storeDir_(outDir_ / kStoreDirName) {}
+
+    bool prepare() {
+        std::error_code ec;
+        std::filesystem::create_directories(storeDir_, ec);
+        return !ec;
+    }
+
+    std::filesystem::path storePath(const StoreKey& key) const {
+        std::stringstream ss;
+        ss << std::hex << std::setfill('0') << std::setw(16) << key.hash << "_" << std::dec << key.size << ".bin";
+        return storeDir_ / ss.str();
+    }
+
+    // O tamanho entra como seed: blocos de tamanhos diferentes nunca colidem.
+    static uint64_t rawKey(ByteView rawBlock) {
+        return XXH64::hash(rawBlock.data(), rawBlock.size(), rawBlock.size());
+    }
+
+    const StoreKey* findRaw(uint64_t rawKey) const {
+        auto it = byRaw_.find(rawKey);
+        return it == byRaw_.end() ? nullptr : &it->second;
+    }
+
+    /**
+     * @brief Registra um conteúdo recém-descomprimido. Retorna true se ele
+     * precisa ser gravado na store (primeira vez e ainda não está no disco).
+     */
+    bool add(uint64_t rawKey, const StoreKey& key) {
+        byRaw_[rawKey] = key;
+        uint64_t id = key.hash ^ (key.size * 0x9E3779B97F4A7C15ull);
+        if (!known_.insert(id).second) {
+            contentRepeats++;
+            savedBytes += key.size;
+            return false;
+        }
+        std::error_code ec;
+        uint64_t onDisk = std::filesystem::file_size(storePath(key), ec);
+        return ec || onDisk != key.size;
+    }
+
+    void repeatedRaw(const StoreKey& key) {
+        rawRepeats++;
+        savedBytes += key.size;
+    }
+
+    // Os links só são criados no fim, depois que o escritor gravou a store.
+    void link(const StoreKey& key, const std::string& name) {
+        blocks++;
+        links_.emplace_back(key, name);
+    }
+
+    /**
+     * @brief Cria os nomes por offset. Retorna quantos não puderam ser criados.
+     */
+    size_t finishLinks() {
+        size_t failed = 0;
+        for (const auto& l : links_) {
+            std::filesystem::path target = storePath(l.first);
+            std::filesystem::path name = outDir_ / l.second;
+            std::error_code ec;
+            if (std::filesystem::equivalent(name, target, ec)) continue;
+            std::filesystem::remove(name, ec);
+            std::filesystem::create_hard_link(target, name, ec);
+            if (ec) {
+                ec.clear();
+                std::filesystem::copy_file(target, name, ec);
+            }
+            if (ec) {
+                std::cerr << "Erro ao criar " << name.string() << ": " << ec.message() << std::endl;
+                failed++;
+            }
+        }
+        return failed;
+    }
+
+    size_t uniqueCount() const { return known_.size(); }
+
+private:
+    std::filesystem::path outDir_;
+    std::filesystem::path storeDir_;
+    std::unordered_map<uint64_t, StoreKey> byRaw_;
+    std::unordered_set<uint64_t> known_;
+    std::vector<std::pair<StoreKey, std::string>> links_;
+};
+
+/**
+ * @brief Descomprime cada bloco e entrega o resultado ao estágio escritor,
+ * contando sucessos e falhas. Usado pelos dois caminhos de extração.
+ */
+struct ExtractionTally {
+    std::string outDir;
+    OutputWriter& writer;
+    std::unique_ptr<OutputIndex> index; // chunks soltos sem --dedup
+    std::unique_ptr<ChunkStore> store;  // --dedup
+    bool quiet = false;
+    std::atomic<int> ok{ 0 };
+    std::atomic<int> err{ 0 };
+
+    ExtractionTally(const std::string& dir, OutputWriter& w, const ProcessOptions& opts)
+        : outDir(dir), writer(w), quiet(opts.quiet) {
+        if (opts.packOutput) return;
+        if (opts.dedup) {
+            store = std::make_unique<ChunkStore>(dir);
+            if (!store->prepare()) {
+                std::cerr << "Aviso: nao foi possivel criar " << kStoreDirName << "; extraindo sem dedup." << std::endl;
+                store.reset();
+            }
+        }
+        if (!store) {
+            index = std::make_unique<OutputIndex>(dir, opts.skipUnchanged);
+            index->load();
+        }
+    }
+
+    void run(const ScanResult& blockInfo, ByteView rawBlock) {
+        try {
+            uint64_t rawKey = 0;
+            if (store) {
+                rawKey = ChunkStore::rawKey(rawBlock);
+                if (const StoreKey* seen = store->findRaw(rawKey)) {
+                    // Mesmo bloco comprimido já visto: nem descomprime.
+                    store->repeatedRaw(*seen);
+                    store->link(*seen, chunkFileName(blockInfo.offset, (size_t)seen->size));
+                    ok++;
+                    return;
+                }
+            }
+
+            // Descomprime usando a função de extração (direto do mapeamento/janela, sem cópia)
+            XXH64 hash;
+            std::vector<uint8_t> decompressedData;
+            {
+                TraceScope trace("decode");
+                trace.arg("bytes", rawBlock.size());
+                decompressedData = decompressLZSSBlock(rawBlock, (index || store) ? &hash : nullptr);
+            }
+
+            // Verifica se o tamanho bate (checagem de sanidade)
+            if (decompressedData.size() != blockInfo.decompressedSize) {
+                std::cerr << "Warning: Tamanho descomprimido (do scan) " << blockInfo.decompressedSize
+                    << " nao bate com (da extracao) " << decompressedData.size()
+                    << " no offset " << blockInfo.offset << std::endl;
+            }
+
+            std::string name;
+            {
+                TraceScope trace("name");
+                name = chunkFileName(blockInfo.offset, decompressedData.size());
+            }
+            if (store) {
+                TraceScope trace("store");
+                StoreKey key;
+                key.hash = hash.digest();
+                key.size = decompressedData.size();
+                if (store->add(rawKey, key)) {
+                    writer.submit({ store->storePath(key), std::move(decompressedData), blockInfo });
+                }
+                store->link(key, name);
+                ok++;
+                return;
+            }
+            if (index) {
+                TraceScope trace("skip_check");
+                if (index->unchanged(name, hash.digest(), decompressedData.size())) {
+                    ok++;
+                    return;
+                }
+            }
+            std::filesystem::path outFilePath = std::filesystem::path(outDir) / name;
+            // Sobra de uma extração com --dedup: gravar por cima (O_TRUNC) alteraria
+            // a store e todos os outros nomes ligados a ela.
+            std::error_code ec;
+            if (std::filesystem::hard_link_count(outFilePath, ec) > 1 && !ec) std::filesystem::remove(outFilePath, ec);
+            TraceScope trace("submit"); // Inclui a espera quando a fila do escritor está cheia
+            writer.submit({ std::move(outFilePath), std::move(decompressedData), blockInfo });
+            ok++;
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Erro ao extrair bloco no offset 0x" << std::hex << blockInfo.offset << std::dec
+                << ": " << e.what() << std::endl;
+            err++;
+        }
+    }
+
+    // Espera o escritor terminar; falhas de gravação contam como falhas.
+    void finish() {
+        WriterStats st = writer.finish();
+        ok -= (int)st.failed;
+        err += (int)st.failed;
+        printWriterStats(writer, st);
+        finishOutputs();
+    }
+
+    // Links da store e índice de saída; no --batch, chamado por container
+    // depois que o escritor compartilhado terminou.
+    void finishOutputs() {
+        if (store) {
+            size_t failed = store->finishLinks();
+            ok -= (int)failed;
+            err += (int)failed;
+            if (!quiet) std::cout << "Dedup: " << store->blocks << " blocos, " << store->uniqueCount() << " conteudos unicos; "
+                << store->rawRepeats << " repetidos sem descomprimir, " << store->contentRepeats
+                << " pelo conteudo; " << std::fixed << std::setprecision(2)
+                << store->savedBytes / (1024.0 * 1024.0) << " MB nao gravados" << std::defaultfloat << std::endl;
+        }
+        if (index) {
+            if (index->skipped > 0 && !quiet) {
+                std::cout << "Inalterados (nao regravados): " << index->skipped << " arquivos, "
+                    << std::fixed << std::setprecision(2) << index->savedBytes / (1024.0 * 1024.0)
+                    << " MB de escrita economizados" << std::defaultfloat << std::endl;
+            }
+            if (!index->save()) {
+                std::cerr << "Aviso: nao foi possivel gravar o indice de saida em " << outDir << std::endl;
+            }
+        }
+    }
+};
+
+/**
+ * @brief Caminho em janelas: cada bloco é extraído assim que o scan o
+ * confirma, enquanto os bytes ainda estão na janela.
+ */
+bool processContainerStreaming(const std::string& inPath, const std::string& outDir, const ProcessOptions& opts) {
+    FileReader reader;
+    if (!reader.open(inPath)) {
+        std::cerr << "Erro: Nao foi possivel abrir o arquivo de entrada: " << inPath << std::endl;
+        return false;
+    }
+    if (reader.size() == 0) {
+        std::cerr << "Erro: O arquivo de entrada esta vazio." << std::endl;
+        return false;
+    }
+
+    ProgressReporter progress(opts.progressMode, opts.progressIntervalMs);
+    std::unique_ptr<OutputWriter> writer = makeExtractionWriter(outDir, opts);
+    if (!writer) return false;
+    ExtractionTally tally(outDir, *writer, opts);
+    std::vector<ScanResult> blocks = scanContainerStreaming(reader,
+        opts.streamWindow ? opts.streamWindow : kDefaultStreamWindow,
+        opts.maxBlock ? opts.maxBlock : kDefaultStreamMaxBlock, &progress,
+        [&](const ScanResult& blockInfo, ByteView raw) { tally.run(blockInfo, raw); });
+    tally.finish();
+
+    if (cancelRequested()) {
+        std::cout << "Extração cancelada: " << tally.ok << " OK, " << tally.err << " Falhas." << std::endl;
+        return false;
+    }
+    if (blocks.empty()) {
+        std::cout << "Nenhum bloco LZSS valido foi encontrado." << std::endl;
+        return true;
+    }
+    std::cout << "Extração concluída: " << tally.ok << " OK, " << tally.err << " Falhas." << std::endl;
+    return true;
+}
+
+bool processContainerFile(const std::string& inPath, const std::string& outDir, const ProcessOptions& opts = {}) {
+    TraceScope trace("process");
+    std::cout << "Processando arquivo: " << inPath << std::endl;
+    std::cout << "Salvando em: " << outDir << std::endl;
+
+    // 1. Criar diretório de saída (no modo pack, só o diretório que contém o pack)
+    try {
+        std::filesystem::path dir = opts.packOutput ? std::filesystem::path(outDir).parent_path() : std::filesystem::path(outDir);
+        if (!dir.empty()) std::filesystem::create_directories(dir);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Erro: Nao foi possivel criar o diretorio de saida: " << e.what() << std::endl;
+        return false;
+    }
+
+    // 2. Ler arquivo de entrada (mapeado; em janelas se pedido ou se o
+    //    arquivo não couber no espaço de endereçamento / na memória)
+    MappedFile inputData;
+    if (opts.streamWindow > 0) {
+        return processContainerStreaming(inPath, outDir, opts);
+    }
+    bool mapped;
+    {
+        TraceScope mapTrace("map");
+        mapped = inputData.open(inPath);
+    }
+    if (!mapped) {
+        if (!std::filesystem::exists(inPath)) {
+            std::cerr << "Erro: Nao foi possivel abrir o arquivo de entrada: " << inPath << std::endl;
+            return false;
+        }
+        std::cout << "Aviso: nao foi possivel mapear o arquivo; usando leitura em janelas." << std::endl;
+        return processContainerStreaming(inPath, outDir, opts);
+    }
+    if (inputData.empty()) {
+        std::cerr << "Erro: O arquivo de entrada esta vazio." << std::endl;
+        return false;
+    }
+
+    // 3. Escanear por blocos LZSS
+    ProgressReporter progress(opts.progressMode, opts.progressIntervalMs);
+    std::vector<ScanResult> blocks = scanContainer(inputData.view(), &progress);
+    if (cancelRequested()) {
+        std::cout << "Cancelado antes da extracao. Nenhum arquivo foi gravado." << std::endl;
+        return false;
+    }
+    if (blocks.empty()) {
+        std::cout << "Nenhum bloco LZSS valido foi encontrado." << std::endl;
+        return true;
+    }
+
+    // 4. Extrair cada bloco (a gravação roda em paralelo no estágio escritor)
+    std::unique_ptr<OutputWriter> writer = makeExtractionWriter(outDir, opts);
+    if (!writer) return false;
+    ExtractionTally tally(outDir, *writer, opts);
+    uint64_t totalConsumed = 0;
+    for (const auto& b : blocks) totalConsumed += b.consumedSize;
+    uint64_t doneConsumed = 0;
+    progress.begin("extract", totalConsumed);
+    for (const auto& blockInfo : blocks) {
+        // Checado entre blocos: cada arquivo já gravado está completo.
+        if (cancelRequested()) break;
+        // Pega o bloco comprimido (raw) direto do mapeamento
+        tally.run(blockInfo, ByteView(inputData.data() + blockInfo.offset, blockInfo.consumedSize));
+        doneConsumed += blockInfo.consumedSize;
+        progress.tick(doneConsumed, blocks.size(), tally.ok + tally.err);
+    }
+
+    progress.end(doneConsumed, blocks.size(), tally.ok + tally.err);
+    tally.finish();
+
+    if (cancelRequested()) {
+        std::cout << "Extração cancelada: " << tally.ok << " OK, " << tally.err << " Falhas, "
+            << (blocks.size() - tally.ok - tally.err) << " nao processados." << std::endl;
+        return false;
+    }
+    std::cout << "Extração concluída: " << tally.ok << " OK, " << tally.err << " Falhas." << std::endl;
+    return true;
+}
+
+
+// Grava o bloco extraído em 'outPath' (vazio = stdout, em modo binário).
+static bool writeExtractedBlock(ByteView data, const std::string& outPath) {
+    if (outPath.empty()) {
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        if (!data.empty() && std::fwrite(data.data(), 1, data.size(), stdout) != data.size()) {
+            std::cerr << "Erro: falha ao escrever no stdout." << std::endl;
+            return false;
+        }
+        return std::fflush(stdout) == 0;
+    }
+
+    std::string error;
+    if (!writeWholeFile(outPath, data.data(), data.size(), error)) {
+        std::cerr << "Erro ao gravar " << outPath << ": " << error << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief --extract-at sobre um pack (--pack): o chunk do offset 'offset' do
+ * container original é achado pela busca no índice e sai direto do
+ * mapeamento, conferido pelo hash, sem descomprimir nada.
+ */
+static bool extractPackChunkAt(const std::string& packPath, uint64_t offset, const std::string& outPath) {
+    PackReader pack;
+    if (!pack.open(packPath)) {
+        std::cerr << "Erro: Pack invalido ou ilegivel: " << packPath << std::endl;
+        return false;
+    }
+    PackEntry e;
+    if (!pack.find(offset, e)) {
+        std::cerr << "Erro: nenhum chunk do offset 0x" << std::hex << offset << std::dec << " no pack." << std::endl;
+        return false;
+    }
+    ByteView data = pack.data(e);
+    if (XXH64::hash(data.data(), data.size()) != e.hash) {
+        std::cerr << "Erro: hash nao confere para o chunk do offset 0x" << std::hex << offset << std::dec << std::endl;
+        return false;
+    }
+    if (!writeExtractedBlock(data, outPath)) return false;
+    if (!outPath.empty()) {
+        std::cerr << "Chunk 0x" << std::hex << offset << std::dec << " (pack): " << data.size()
+            << " bytes gravados em " << outPath << std::endl;
+    }
+    return true;
+}
+
+/**
+ * @brief Modo --extract-at: valida e descomprime só o bloco no offset dado,
+ * sem scan, e grava em 'outPath' (vazio = stdout). Feito para ser chamado
+ * sob demanda por scripts e editores: o arquivo é mapeado e só as páginas
+ * do bloco são lidas. Se o arquivo for um pack do --pack, o chunk vem do
+ * índice dele (extractPackChunkAt).
+ */
+bool extractBlockAt(const std::string& inPath, uint64_t offset, const std::string& outPath) {
+    TraceScope trace("extract_at");
+    MappedFile inputData;
+    if (!inputData.open(inPath)) {
+        std::cerr << "Erro: Nao foi possivel abrir o arquivo de entrada: " << inPath << std::endl;
+        return false;
+    }
+    if (inputData.size() >= kPackHeaderSize && std::equal(kPackMagic, kPackMagic + 4, inputData.data())) {
+        return extractPackChunkAt(inPath, offset, outPath);
+    }
+    if (offset >= inputData.size()) {
+        std::cerr << "Erro: offset 0x" << std::hex << offset << std::dec << " fora do arquivo ("
+            << inputData.size() << " bytes)." << std::endl;
+        return false;
+    }
+
+    size_t remaining = inputData.size() - (size_t)offset;
+    DecompressValidationResult v = validateLZSSBlock(inputData.data() + offset, remaining, remaining);
+    if (!v.success) {
+        std::cerr << "Erro: nenhum bloco LZSS valido no offset 0x" << std::hex << offset << std::dec << std::endl;
+        return false;
+    }
+
+    std::vector<uint8_t> decompressedData;
+    try {
+        decompressedData = decompressLZSSBlock(ByteView(inputData.data() + offset, v.consumedBytes));
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Erro ao extrair bloco no offset 0x" << std::hex << offset << std::dec
+            << ": " << e.what() << std::endl;
+        return false;
+    }
+
+    if (!writeExtractedBlock(decompressedData, outPath)) return false;
+    if (outPath.empty()) return true;
+    std::cerr << "Bloco 0x" << std::hex << offset << std::dec << ": " << v.consumedBytes << " -> "
+        << decompressedData.size() << " bytes gravados em " << outPath << std::endl;
+    return true;
+}
+
+// --- Compressão de Arquivos (--compress / --bench-compress) ---
+
+bool readWholeFile(const std::string& path, std::vector<uint8_t>& data) {
+    MappedFile file;
+    if (!file.open(path)) return false;
+    data.assign(file.data(), file.data() + file.size());
+    return true;
+}
+
+/**
+ * @brief Modo --compress: um arquivo vira um bloco LZSS pronto para ser
+ * reinserido no container. Arquivos grandes usam 'threads' para achar os matches.
+ */
+bool compressFile(const std::string& inPath, const std::string& outPath, int level, unsigned threads, size_t budget = 0,
+    const EncoderModel* emulate = nullptr) {
+    MappedFile input;
+    if (!input.open(inPath)) {
+        std::cerr << "Erro: Nao foi possivel abrir o arquivo de entrada: " << inPath << std::endl;
+        return false;
+    }
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<uint8_t> block;
+    if (emulate) block = compressEmulated(input.view(), *emulate);
+    if (budget && (!emulate || block.size() > budget)) {
+        FitResult fit = compressLZSSBlockToFit(input.view(), budget, level, threads);
+        if (!fit.fits) {
+            std::cerr << "Erro: " << inPath << " nao coube em " << budget << " bytes; o menor alcancado foi "
+                << fit.block.size() << " bytes (" << fit.strategy << "). Nada foi gravado." << std::endl;
+            return false;
+        }
+        std::cout << "Cabe em " << budget << " bytes com: " << fit.strategy << std::endl;
+        block = std::move(fit.block);
+    }
+    else if (!emulate) {
+        block = compressLZSSBlock(input.view(), level, threads);
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::string error;
+    if (!writeWholeFile(outPath, block.data(), block.size(), error)) {
+        std::cerr << "Erro ao gravar " << outPath << ": " << error << std::endl;
+        return false;
+    }
+    std::cout << inPath << ": " << input.size() << " -> " << block.size() << " bytes ("
+        << std::fixed << std::setprecision(1) << (input.size() ? 100.0 * block.size() / input.size() : 0.0)
+        << "%) em " << std::setprecision(3) << secs << "s, " << (emulate ? "encoder " + emulate->name() : "nivel " + std::to_string(level))
+        << std::defaultfloat << std::endl;
+    return true;
+}
+
+/**
+ * @brief Modo --bench-compress: comprime o arquivo (ou cada arquivo do
+ * diretório, um bloco por arquivo) em todos os níveis, confere a ida e
+ * volta e mostra tamanho e velocidade de cada nível. Com 'threads' > 1,
+ * comprime também com a tabela de matches paralela e confere que o bloco
+ * sai idêntico ao serial.
+ */
+bool benchCompress(const std::string& path, unsigned threads) {
+    std::vector<std::string> files;
+    std::error_code ec;
+    if (std::filesystem::is_directory(path, ec)) {
+        for (const auto& entry : std::filesystem::directory_iterator(path, ec)) {
+            if (entry.is_regular_file(ec)) files.push_back(entry.path().string());
+        }
+        std::sort(files.begin(), files.end());
+    }
+    else {
+        files.push_back(path);
+    }
+
+    std::vector<std::vector<uint8_t>> inputs;
+    uint64_t totalIn = 0;
+    for (const auto& f : files) {
+        std::vector<uint8_t> data;
+        if (!readWholeFile(f, data)) {
+            std::cerr << "Erro: Nao foi possivel ler " << f << std::endl;
+            return false;
+        }
+        totalIn += data.size();
+        inputs.push_back(std::move(data));
+    }
+    if (totalIn == 0) {
+        std::cerr << "Erro: nada para comprimir em " << path << std::endl;
+        return false;
+    }
+
+    std::cout << files.size() << " arquivo(s), " << totalIn << " bytes\n";
+    std::cout << "nivel      saida   razao  comp MB/s  desc MB/s";
+    if (threads > 1) std::cout << "  " << std::setw(2) << threads << " thr MB/s";
+    std::cout << "\n";
+    bool allOk = true;
+    for (int level = 0; level <= kMaxCompressLevel; level++) {
+        uint64_t totalOut = 0;
+        double compSecs = 0, decSecs = 0, parSecs = 0;
+        bool ok = true, same = true;
+        for (const auto& in : inputs) {
+            auto t0 = std::chrono::steady_clock::now();
+            std::vector<uint8_t> block = compressLZSSBlock(in, level);
+            auto t1 = std::chrono::steady_clock::now();
+            std::vector<uint8_t> back = decompressLZSSBlock(block);
+            auto t2 = std::chrono::steady_clock::now();
+            compSecs += std::chrono::duration<double>(t1 - t0).count();
+            decSecs += std::chrono::duration<double>(t2 - t1).count();
+            totalOut += block.size();
+            if (back != in) ok = false;
+            if (threads > 1) {
+                auto t3 = std::chrono::steady_clock::now();
+                if (compressLZSSBlock(in, level, threads) != block) same = false;
+                parSecs += std::chrono::duration<double>(std::chrono::steady_clock::now() - t3).count();
+            }
+        }
+        allOk = allOk && ok;
+        double mb = totalIn / (1024.0 * 1024.0);
+        std::cout << std::setw(5) << level << std::setw(11) << totalOut << std::fixed << std::setprecision(3)
+            << std::setw(8) << (double)totalOut / totalIn << std::setprecision(1)
+            << std::setw(11) << mb / std::max(compSecs, 1e-9) << std::setw(11) << mb / std::max(decSecs, 1e-9);
+        if (threads > 1) std::cout << std::setw(14) << mb / std::max(parSecs, 1e-9);
+        std::cout << std::defaultfloat << (ok ? "" : "  ERRO: ida e volta nao confere")
+            << (same ? "" : "  ERRO: paralelo difere do serial") << std::endl;
+        allOk = allOk && same;
+    }
+
+    // Mesmos níveis com cada buscador, para comparar a hash chain com a árvore.
+    std::cout << "\nnivel   chain saida  chain MB/s   arvore saida  arvore MB/s\n";
+    for (int level = 1; level <= kMaxCompressLevel; level++) {
+        std::cout << std::setw(5) << level;
+        for (MatchFinderKind kind : { MatchFinderKind::HashChain, MatchFinderKind::BinaryTree }) {
+            CompressLevel cfg = kCompressLevels[level];
+            cfg.finder = kind;
+            uint64_t totalOut = 0;
+            double secs = 0;
+            bool ok = true;
+            for (const auto& in : inputs) {
+                auto t0 = std::chrono::steady_clock::now();
+                std::vector<uint8_t> block = compressLZSSBlock(in, cfg);
+                secs += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+                totalOut += block.size();
+                if (decompressLZSSBlock(block) != in) ok = false;
+            }
+            allOk = allOk && ok;
+            std::cout << std::setw(14) << totalOut << std::fixed << std::setprecision(1)
+                << std::setw(12) << totalIn / (1024.0 * 1024.0) / std::max(secs, 1e-9) << std::defaultfloat
+                << (ok ? "" : " ERRO");
+        }
+        std::cout << std::endl;
+    }
+    return allOk;
+}
+
+// --- Modo Lote (--batch) ---
+//
+// Processa muitos containers sem interação. Scan e extração de todos eles
+// viram tarefas de um único pool com roubo de tarefas: o scan de um
+// container é dividido em fatias de kBatchScanSlice, e quando a última
+// fatia termina as extrações são geradas em grupos de ~kBatchExtractBytes.
+// Assim um container enorme ocupa todos os núcleos e vários pequenos
+// rodam lado a lado, sem núcleo parado entre um arquivo e outro. Os
+// containers começam do maior para o menor e, enquanto os ativos são
+// processados, o próximo já está mapeado e sendo lido pelo SO (prefetch).
+
+constexpr size_t kBatchScanSlice = 4 * 1024 * 1024;
+constexpr size_t kBatchExtractBytes = 1024 * 1024;
+
+/**
+ * @brief Pool de threads em que cada worker tem sua própria fila. O worker
+ * pega a tarefa mais recente da sua fila (dados ainda no cache) e, sem
+ * tarefas, rouba a mais antiga da fila de outro. Tarefas criadas dentro
+ * de uma tarefa vão para a fila do próprio worker.
+ */
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(unsigned threads) {
+        if (threads == 0) threads = 1;
+        for (unsigned i = 0; i < threads; i++) queues_.push_back(std::make_unique<WorkerQueue>());
+        for (unsigned i = 0; i < threads; i++) threads_.emplace_back([this, i] { run(i); });
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& t : threads_) t.join();
+    }
+
+    void submit(std::function<void()> task) {
+        size_t q = (t_pool == this) ? t_index : next_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+        {
+            std::lock_guard<std::mutex> lock(queues_[q]->mutex);
+            queues_[q]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queued_++;
+            pending_++;
+        }
+        wake_.notify_one();
+    }
+
+    // Espera até 'timeout' pelo fim de todas as tarefas; true se acabaram.
+    bool waitFor(std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return done_.wait_for(lock, timeout, [&] { return pending_ == 0; });
+    }
+
+    unsigned size() const { return (unsigned)threads_.size(); }
+
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool take(size_t self, std::function<void()>& task) {
+        {
+            WorkerQueue& own = *queues_[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+        for (size_t k = 1; k < queues_.size(); k++) {
+            WorkerQueue& victim = *queues_[(self + k) % queues_.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(size_t self) {
+        t_pool = this;
+        t_index = self;
+        traceThreadName("pool " + std::to_string(self));
+        std::function<void()> task;
+        while (true) {
+            {
+                // 'queued_' conta tarefas nas filas ainda sem dono: quem o
+                // decrementa tem garantida uma tarefa em alguma fila.
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return queued_ > 0 || stop_; });
+                if (queued_ == 0) return;
+                queued_--;
+            }
+            while (!take(self, task)) std::this_thread::yield();
+            try {
+                task();
+            }
+            catch (const std::exception& e) {
+                std::cerr << "Erro numa tarefa do lote: " << e.what() << std::endl;
+            }
+            task = nullptr;
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--pending_ == 0) done_.notify_all();
+        }
+    }
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> next_{ 0 };
+    std::mutex mutex_;
+    std::condition_variable wake_, done_;
+    size_t queued_ = 0;
+    size_t pending_ = 0;
+    bool stop_ = false;
+
+    static inline thread_local WorkStealingPool* t_pool = nullptr;
+    static inline thread_local size_t t_index = 0;
+};
+
+static bool wildcardMatch(const char* pattern, const char* name) {
+    if (*pattern == '\0') return *name == '\0';
+    if (*pattern == '*') return wildcardMatch(pattern + 1, name) || (*name && wildcardMatch(pattern, name + 1));
+    if (*name && (*pattern == '?' || *pattern == *name)) return wildcardMatch(pattern + 1, name + 1);
+    return false;
+}
+
+/**
+ * @brief Expande as entradas do --batch: diretório (os arquivos dentro
+ * dele), "@lista.txt" (um caminho por linha, '#' comenta), padrão com * ou
+ * ? no nome do arquivo, ou um arquivo comum.
+ */
+bool expandBatchInputs(const std::vector<std::string>& specs, std::vector<std::string>& out) {
+    bool ok = true;
+    for (const std::string& spec : specs) {
+        std::error_code ec;
+        if (!spec.empty() && spec[0] == '@') {
+            std::ifstream list(std::filesystem::path(spec.substr(1)));
+            if (!list) {
+                std::cerr << "Erro: Nao foi possivel abrir a lista: " << spec.substr(1) << std::endl;
+                ok = false;
+                continue;
+            }
+            std::string line;
+            while (std::getline(list, line)) {
+                while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t')) line.pop_back();
+                size_t start = line.find_first_not_of(" \t");
+                if (start == std::string::npos || line[start] == '#') continue;
+                out.push_back(line.substr(start));
+            }
+            continue;
+        }
+
+        std::filesystem::path path(spec);
+        if (std::filesystem::is_directory(path, ec)) {
+            std::vector<std::string> found;
+            for (const auto& entry : std::filesystem::directory_iterator(path, ec)) {
+                if (entry.is_regular_file(ec)) found.push_back(entry.path().string());
+            }
+            std::sort(found.begin(), found.end());
+            out.insert(out.end(), found.begin(), found.end());
+            continue;
+        }
+
+        std::string pattern = path.filename().string();
+        if (pattern.find_first_of("*?") != std::string::npos) {
+            std::filesystem::path dir = path.parent_path().empty() ? std::filesystem::path(".") : path.parent_path();
+            std::vector<std::string> found;
+            for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+                if (entry.is_regular_file(ec) && wildcardMatch(pattern.c_str(), entry.path().filename().string().c_str())) {
+                    found.push_back(entry.path().string());
+                }
+            }
+            if (found.empty()) std::cerr << "Aviso: nenhum arquivo corresponde a " << spec << std::endl;
+            std::sort(found.begin(), found.end());
+            out.insert(out.end(), found.begin(), found.end());
+            continue;
+        }
+
+        out.push_back(spec);
+    }
+
+    // O mesmo container citado duas vezes (ex.: diretório e lista) gravaria
+    // a mesma pasta de saída em paralelo.
+    std::unordered_set<std::string> seen;
+    std::vector<std::string> unique;
+    for (auto& in : out) {
+        std::error_code ec;
+        std::filesystem::path canon = std::filesystem::weakly_canonical(in, ec);
+        if (seen.insert(ec ? in : canon.string()).second) unique.push_back(std::move(in));
+    }
+    out.swap(unique);
+    return ok;
+}
+
+struct BatchContainer {
+    std::string inPath;
+    std::filesystem::path outDir;
+    MappedFile file;
+    std::vector<std::vector<ScanResult>> slices; // resultados de cada fatia do scan
+    std::atomic<size_t> slicesLeft{ 0 };
+    std::atomic<size_t> groupsLeft{ 0 };
+    std::atomic<uint64_t> candidates{ 0 };
+    std::vector<ScanResult> blocks;
+    std::unique_ptr<ExtractionTally> tally;
+    std::chrono::steady_clock::time_point start;
+};
+
+class BatchRunner {
+public:
+    BatchRunner(std::vector<std::string> inputs, const std::string& outRoot, const ProcessOptions& opts)
+        : inputs_(std::move(inputs)), outRoot_(outRoot), opts_(opts) {}
+
+    bool run() {
+        // Maior primeiro: um container enorme no fim deixaria os outros núcleos parados.
+        std::vector<std::pair<uint64_t, std::string>> sized;
+        for (const auto& in : inputs_) {
+            std::error_code ec;
+            uint64_t sz = std::filesystem::file_size(in, ec);
+            sized.emplace_back(ec ? 0 : sz, in);
+            totalBytes_ += ec ? 0 : sz;
+        }
+        std::stable_sort(sized.begin(), sized.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+        for (size_t i = 0; i < sized.size(); i++) inputs_[i] = sized[i].second;
+
+        unsigned jobs = opts_.jobs ? opts_.jobs : std::max(1u, std::thread::hardware_concurrency());
+        maxActive_ = jobs;
+        auto t0 = std::chrono::steady_clock::now();
+
+        std::unique_ptr<OutputWriter> writer = makeOutputWriter(opts_.writer);
+        writer_ = writer.get();
+        ProgressReporter progress(opts_.quiet && opts_.progressMode == ProgressMode::Console
+            ? ProgressMode::None : opts_.progressMode, opts_.progressIntervalMs);
+        {
+            WorkStealingPool pool(jobs);
+            pool_ = &pool;
+            progress.begin("batch", totalBytes_);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                startNext();
+            }
+            auto interval = std::chrono::milliseconds(std::max(50u, opts_.progressIntervalMs));
+            while (!pool.waitFor(interval)) {
+                progress.tick(scannedBytes_.load(), candidates_.load(), blocks_.load());
+            }
+            progress.end(scannedBytes_.load(), candidates_.load(), blocks_.load());
+        }
+
+        WriterStats st = writer->finish();
+        if (!opts_.quiet) printWriterStats(*writer, st);
+        int ok = 0, err = 0;
+        for (auto& c : containers_) {
+            c->tally->finishOutputs();
+            ok += c->tally->ok;
+            err += c->tally->err;
+        }
+        ok -= (int)st.failed;
+        err += (int)st.failed;
+
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        std::cout << (cancelRequested() ? "Lote cancelado: " : "Lote concluido: ")
+            << containers_.size() << " containers (" << failedContainers_ << " com erro), "
+            << ok << " blocos OK, " << err << " Falhas, " << std::fixed << std::setprecision(2)
+            << secs << "s com " << jobs << " threads." << std::defaultfloat << std::endl;
+        return !cancelRequested() && failedContainers_ == 0 && err == 0;
+    }
+
+private:
+    // Abre (mapeia) o container e já pede a leitura antecipada ao SO.
+    std::unique_ptr<BatchContainer> openContainer(size_t i) {
+        auto c = std::make_unique<BatchContainer>();
+        c->inPath = inputs_[i];
+        TraceScope trace("map");
+        std::filesystem::path inPath(c->inPath);
+        std::filesystem::path base = outRoot_.empty() ? inPath.parent_path() : std::filesystem::path(outRoot_);
+        c->outDir = base / (inPath.filename().string() + "_decompressed");
+        if (!c->file.open(c->inPath)) {
+            std::cerr << "Erro: Nao foi possivel abrir o arquivo de entrada: " << c->inPath << std::endl;
+            failedContainers_++;
+            return nullptr;
+        }
+        c->file.prefetch();
+        return c;
+    }
+
+    // Chamado com 'mutex_' travado.
+    void startNext() {
+        while (active_ < maxActive_ && !cancelRequested() && (prefetched_ || next_ < inputs_.size())) {
+            std::unique_ptr<BatchContainer> c = prefetched_ ? std::move(prefetched_) : openContainer(next_++);
+            if (next_ < inputs_.size()) prefetched_ = openContainer(next_++);
+            if (c) launch(std::move(c));
+        }
+    }
+
+    void launch(std::unique_ptr<BatchContainer> owned) {
+        BatchContainer* c = owned.get();
+        containers_.push_back(std::move(owned));
+        c->start = std::chrono::steady_clock::now();
+        std::error_code ec;
+        std::filesystem::create_directories(c->outDir, ec);
+        if (ec) {
+            std::cerr << "Erro: Nao foi possivel criar o diretorio de saida " << c->outDir.string()
+                << ": " << ec.message() << std::endl;
+            failedContainers_++;
+        }
+        c->tally = std::make_unique<ExtractionTally>(c->outDir.string(), *writer_, opts_);
+        active_++;
+
+        size_t n = c->file.size();
+        if (ec || n < 12) {
+            // Via pool: complete() trava 'mutex_', que quem chamou já tem.
+            scannedBytes_ += n;
+            pool_->submit([this, c] { complete(c); });
+            return;
+        }
+        size_t count = (n - 11 + kBatchScanSlice - 1) / kBatchScanSlice;
+        c->slices.resize(count);
+        c->slicesLeft = count;
+        for (size_t i = 0; i < count; i++) {
+            size_t from = i * kBatchScanSlice;
+            size_t to = std::min(n - 11, from + kBatchScanSlice);
+            pool_->submit([this, c, i, from, to] { scanSlice(c, i, from, to); });
+        }
+    }
+
+    void scanSlice(BatchContainer* c, size_t i, size_t from, size_t to) {
+        if (!cancelRequested()) {
+            uint64_t candidates = 0;
+            scanRange(c->file.view(), from, to, c->slices[i], candidates);
+            c->candidates += candidates;
+            candidates_ += candidates;
+        }
+        scannedBytes_ += to - from;
+        if (--c->slicesLeft == 0) finishScan(c);
+    }
+
+    void finishScan(BatchContainer* c) {
+        std::vector<ScanResult> all;
+        for (auto& slice : c->slices) {
+            all.insert(all.end(), slice.begin(), slice.end());
+            std::vector<ScanResult>().swap(slice);
+        }
+        c->blocks = dedupScanResults(all);
+        blocks_ += c->blocks.size();
+        if (cancelRequested() || c->blocks.empty()) {
+            complete(c);
+            return;
+        }
+
+        std::vector<std::pair<size_t, size_t>> groups;
+        size_t first = 0, bytes = 0;
+        for (size_t i = 0; i < c->blocks.size(); i++) {
+            bytes += c->blocks[i].consumedSize;
+            if (bytes >= kBatchExtractBytes || i + 1 == c->blocks.size()) {
+                groups.emplace_back(first, i + 1);
+                first = i + 1;
+                bytes = 0;
+            }
+        }
+        c->groupsLeft = groups.size();
+        for (const auto& g : groups) {
+            pool_->submit([this, c, g] { extractGroup(c, g.first, g.second); });
+        }
+    }
+
+    void extractGroup(BatchContainer* c, size_t first, size_t last) {
+        for (size_t i = first; i < last && !cancelRequested(); i++) {
+            const ScanResult& b = c->blocks[i];
+            c->tally->run(b, ByteView(c->file.data() + b.offset, b.consumedSize));
+        }
+        if (--c->groupsLeft == 0) complete(c);
+    }
+
+    // Último passo de cada container: libera o mapeamento e abre espaço para o próximo.
+    void complete(BatchContainer* c) {
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - c->start).count();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!opts_.quiet) {
+            std::cout << c->inPath << ": " << c->blocks.size() << " blocos, " << c->tally->ok << " OK, "
+                << c->tally->err << " Falhas (" << std::fixed << std::setprecision(2) << secs << "s)"
+                << std::defaultfloat << std::endl;
+        }
+        std::vector<ScanResult>().swap(c->blocks);
+        c->file.close();
+        active_--;
+        startNext();
+    }
+
+    std::vector<std::string> inputs_;
+    std::string outRoot_;
+    ProcessOptions opts_;
+    WorkStealingPool* pool_ = nullptr;
+    OutputWriter* writer_ = nullptr;
+
+    std::mutex mutex_; // protege o que segue (fila de containers)
+    std::vector<std::unique_ptr<BatchContainer>> containers_;
+    std::unique_ptr<BatchContainer> prefetched_;
+    size_t next_ = 0;
+    unsigned active_ = 0;
+    unsigned maxActive_ = 1;
+    std::atomic<size_t> failedContainers_{ 0 };
+
+    uint64_t totalBytes_ = 0;
+    std::atomic<uint64_t> scannedBytes_{ 0 };
+    std::atomic<uint64_t> candidates_{ 0 };
+    std::atomic<uint64_t> blocks_{ 0 };
+};
+
+// --- Compressão em Lote (--compress-dir) ---
+//
+// Recomprime um diretório de chunks extraídos (chunk_off_XXXXXXXX_dec_N.bin,
+// como gravados por processContainerFile) depois de editados. Cada chunk
+// vira um bloco LZSS em <saida>/block_off_XXXXXXXX.lzss e o manifesto de
+// saída (mesmo formato do --manifest) guarda, por offset original, o
+// tamanho comprimido novo e o descomprimido: é a entrada da reinserção.
+// Os arquivos são distribuídos entre os threads do maior para o menor,
+// cada thread pegando o próximo da lista quando termina o seu.
+
+/**
+ * @brief Lê o offset original do nome chunk_off_XXXXXXXX_dec_N.bin.
+ */
+bool parseChunkFileName(const std::string& name, uint64_t& offset, uint64_t& decompressedSize) {
+    const std::string prefix = "chunk_off_", mid = "_dec_", suffix = ".bin";
+    if (name.size() <= prefix.size() + mid.size() + suffix.size()) return false;
+    if (name.compare(0, prefix.size(), prefix) != 0) return false;
+    if (name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) return false;
+    size_t midPos = name.find(mid, prefix.size());
+    if (midPos == std::string::npos) return false;
+    std::string hex = name.substr(prefix.size(), midPos - prefix.size());
+    std::string dec = name.substr(midPos + mid.size(), name.size() - suffix.size() - midPos - mid.size());
+    if (hex.empty() || dec.empty() || hex.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos
+        || dec.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    offset = std::stoull(hex, nullptr, 16);
+    decompressedSize = std::stoull(dec);
+    return true;
+}
+
+// Cache de compressão: <saida>/.cache/<xxh64>_<tamanho>_l<nivel>.lzss guarda o
+// bloco gerado para cada conteúdo, junto com o tempo que a compressão levou.
+// Entre uma iteração e outra do mod só os chunks editados são comprimidos de
+// novo. Entradas de outra versão do compressor (kCompressCacheVersion) são
+// ignoradas, e uma entrada só é usada se a ida e volta conferir.
+
+const char* const kCompressCacheDirName = ".cache";
+const char kCompressCacheMagic[4] = { 'T', 'W', 'C', 'C' };
+const uint32_t kCompressCacheVersion = 2; // Mudar quando o compressor passar a gerar blocos diferentes
+const size_t kCompressCacheHeader = 16;   // magic + versão + tempo de compressão (ns)
+
+class CompressCache {
+public:
+    std::atomic<size_t> hits{ 0 };
+    std::atomic<size_t> misses{ 0 };
+    std::atomic<uint64_t> savedNs{ 0 }; // soma do tempo de compressão das entradas reaproveitadas
+
+    CompressCache(const std::filesystem::path& dir, bool readEntries) : dir_(dir), read_(readEntries) {}
+
+    bool prepare() {
+        std::error_code ec;
+        std::filesystem::create_directories(dir_, ec);
+        return !ec;
+    }
+
+    // 'variant' separa blocos do mesmo conteúdo feitos de jeitos diferentes ("l6", "l6_fit1234").
+    std::filesystem::path entryPath(uint64_t hash, uint64_t size, const std::string& variant) const {
+        std::stringstream ss;
+        ss << std::hex << std::setfill('0') << std::setw(16) << hash << "_" << std::dec << size << "_" << variant << ".lzss";
+        return dir_ / ss.str();
+    }
+
+    bool load(const std::filesystem::path& path, std::vector<uint8_t>& block, uint64_t& compressNs) const {
+        if (!read_) return false;
+        std::vector<uint8_t> data;
+        std::error_code ec;
+        if (!std::filesystem::is_regular_file(path, ec) || !readWholeFile(path.string(), data)) return false;
+        if (data.size() < kCompressCacheHeader || !std::equal(kCompressCacheMagic, kCompressCacheMagic + 4, data.begin())) {
+            return false;
+        }
+        uint32_t version = 0;
+        compressNs = 0;
+        for (int i = 0; i < 4; i++) version |= (uint32_t)data[4 + i] << (8 * i);
+        for (int i = 0; i < 8; i++) compressNs |= (uint64_t)data[8 + i] << (8 * i);
+        if (version != kCompressCacheVersion) return false;
+        block.assign(data.begin() + kCompressCacheHeader, data.end());
+        return true;
+    }
+
+    // Grava num nome temporário por thread e renomeia: dois threads com o
+    // mesmo conteúdo nunca deixam uma entrada pela metade.
+    void store(const std::filesystem::path& path, const std::vector<uint8_t>& block, uint64_t compressNs, unsigned worker) {
+        std::vector<uint8_t> data(kCompressCacheHeader);
+        std::copy(kCompressCacheMagic, kCompressCacheMagic + 4, data.begin());
+        for (int i = 0; i < 4; i++) data[4 + i] = (uint8_t)(kCompressCacheVersion >> (8 * i));
+        for (int i = 0; i < 8; i++) data[8 + i] = (uint8_t)(compressNs >> (8 * i));
+        data.insert(data.end(), block.begin(), block.end());
+        std::filesystem::path tmp = path;
+        tmp += ".tmp" + std::to_string(worker);
+        std::string error;
+        std::error_code ec;
+        if (!writeWholeFile(tmp, data.data(), data.size(), error)) return; // Só perde o reaproveitamento
+        std::filesystem::rename(tmp, path, ec);
+        if (ec) std::filesystem::remove(tmp, ec);
+    }
+
+private:
+    std::filesystem::path dir_;
+    bool read_;
+};
+
+std::string compressedBlockName(uint64_t offset) {
+    std::stringstream ss;
+    ss << "block_off_" << std::hex << std::setfill('0') << std::setw(8) << offset << ".lzss";
+    return ss.str();
+}
+
+/**
+ * @brief Com 'fitTo' (manifesto do container original) não vazio, cada
+ * chunk é ajustado ao consumedSize do seu offset (compressLZSSBlockToFit)
+ * para o --repack poder gravá-lo no lugar. Com 'emulate', os blocos saem
+ * do encoder emulado (e só passam pelo ajuste se não couberem).
+ */
+bool compressDirectory(const std::string& inDir, const std::string& outDir, const std::string& manifestName,
+    ManifestFormat fmt, int level, const ProcessOptions& opts, const std::vector<ScanResult>& fitTo = {},
+    const EncoderModel* emulate = nullptr) {
+    struct Item {
+        std::filesystem::path path;
+        uint64_t offset = 0;
+        uint64_t size = 0;
+        uint64_t compressed = 0;
+        size_t budget = 0; // 0 = sem ajuste
+        bool ok = false;
+    };
+    std::vector<Item> items;
+    size_t ignored = 0;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(inDir, ec)) {
+        if (!entry.is_regular_file(ec)) continue;
+        Item item;
+        uint64_t namedSize = 0;
+        if (!parseChunkFileName(entry.path().filename().string(), item.offset, namedSize)) {
+            ignored++;
+            continue;
+        }
+        item.path = entry.path();
+        item.size = entry.file_size(ec);
+        auto orig = std::lower_bound(fitTo.begin(), fitTo.end(), item.offset,
+            [](const ScanResult& b, uint64_t off) { return b.offset < off; });
+        if (orig != fitTo.end() && orig->offset == item.offset) item.budget = orig->consumedSize;
+        items.push_back(std::move(item));
+    }
+    if (ec) {
+        std::cerr << "Erro: Nao foi possivel ler o diretorio " << inDir << ": " << ec.message() << std::endl;
+        return false;
+    }
+    if (items.empty()) {
+        std::cerr << "Erro: nenhum chunk_off_*_dec_*.bin em " << inDir << std::endl;
+        return false;
+    }
+    std::filesystem::create_directories(outDir, ec);
+    if (ec) {
+        std::cerr << "Erro: Nao foi possivel criar o diretorio de saida: " << ec.message() << std::endl;
+        return false;
+    }
+
+    // Maior primeiro: o último arquivo a começar é pequeno, e ninguém fica esperando um gigante.
+    std::stable_sort(items.begin(), items.end(), [](const Item& a, const Item& b) { return a.size > b.size; });
+    uint64_t totalBytes = 0;
+    for (const auto& item : items) totalBytes += item.size;
+
+    unsigned jobs = opts.jobs ? opts.jobs : std::max(1u, std::thread::hardware_concurrency());
+    jobs = (unsigned)std::min<size_t>(jobs, items.size());
+    std::unique_ptr<CompressCache> cache;
+    if (opts.useCompressCache) {
+        std::filesystem::path cacheDir = opts.compressCache.empty()
+            ? std::filesystem::path(outDir) / kCompressCacheDirName : std::filesystem::path(opts.compressCache);
+        cache = std::make_unique<CompressCache>(cacheDir, opts.skipUnchanged); // --force: recomprime, mas atualiza o cache
+        if (!cache->prepare()) {
+            std::cerr << "Aviso: nao foi possivel criar o cache " << cacheDir.string() << "; comprimindo tudo." << std::endl;
+            cache.reset();
+        }
+    }
+
+    std::atomic<size_t> next{ 0 };
+    std::atomic<size_t> finished{ 0 };
+    std::atomic<uint64_t> doneBytes{ 0 };
+    auto worker = [&](unsigned index) {
+        traceThreadName("compress " + std::to_string(index));
+        for (size_t i; (i = next.fetch_add(1)) < items.size() && !cancelRequested();) {
+            Item& item = items[i];
+            MappedFile input;
+            if (!input.open(item.path.string())) {
+                std::cerr << "Erro: Nao foi possivel abrir " << item.path.string() << std::endl;
+            }
+            else {
+                // Confere antes de gravar: um bloco errado só apareceria dentro do jogo.
+                auto roundTrips = [&](const std::vector<uint8_t>& block) {
+                    try {
+                        std::vector<uint8_t> back = decompressLZSSBlock(block);
+                        return back.size() == input.size() && std::equal(back.begin(), back.end(), input.data());
+                    }
+                    catch (const std::exception&) {
+                        return false;
+                    }
+                };
+                std::vector<uint8_t> block;
+                std::filesystem::path cachePath;
+                uint64_t compressNs = 0;
+                bool same = false;
+                if (cache) {
+                    std::string variant = emulate ? "e" + emulate->name() : "l" + std::to_string(level);
+                    if (item.budget) variant += "_fit" + std::to_string(item.budget);
+                    cachePath = cache->entryPath(XXH64::hash(input.data(), input.size(), input.size()), input.size(), variant);
+                    same = cache->load(cachePath, block, compressNs) && roundTrips(block);
+                }
+                if (same) {
+                    cache->hits++;
+                    cache->savedNs += compressNs;
+                }
+                else {
+                    auto c0 = std::chrono::steady_clock::now();
+                    if (emulate) block = compressEmulated(input.view(), *emulate);
+                    if (item.budget && (!emulate || block.size() > item.budget)) {
+                        FitResult fit = compressLZSSBlockToFit(input.view(), item.budget, level);
+                        if (!fit.fits) {
+                            std::cerr << "Aviso: " << item.path.filename().string() << " nao coube nos " << item.budget
+                                << " bytes originais; menor alcancado: " << fit.block.size() << " bytes (sera realocado)\n";
+                        }
+                        block = std::move(fit.block);
+                    }
+                    else if (!emulate) {
+                        block = compressLZSSBlock(input.view(), level);
+                    }
+                    compressNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - c0).count();
+                    same = roundTrips(block);
+                    if (cache) {
+                        cache->misses++;
+                        if (same) cache->store(cachePath, block, compressNs, index);
+                    }
+                }
+                std::string error;
+                if (!same) {
+                    std::cerr << "Erro: ida e volta nao confere para " << item.path.string() << std::endl;
+                }
+                else if (!writeWholeFile(std::filesystem::path(outDir) / compressedBlockName(item.offset),
+                    block.data(), block.size(), error)) {
+                    std::cerr << "Erro ao gravar o bloco de " << item.path.string() << ": " << error << std::endl;
+                }
+                else {
+                    item.compressed = block.size();
+                    item.ok = true;
+                }
+            }
+            doneBytes += item.size;
+            finished++;
+        }
+    };
+
+    auto t0 = std::chrono::steady_clock::now();
+    ProgressReporter progress(opts.progressMode, opts.progressIntervalMs);
+    progress.begin("compress", totalBytes);
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < jobs; i++) threads.emplace_back(worker, i);
+    while (finished.load() < items.size() && !cancelRequested()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(std::max(50u, opts.progressIntervalMs) / 5));
+        progress.tick(doneBytes.load(), items.size(), finished.load());
+    }
+    for (auto& t : threads) t.join();
+    progress.end(doneBytes.load(), items.size(), finished.load());
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::vector<ScanResult> blocks;
+    uint64_t totalOut = 0;
+    size_t failed = 0, budgeted = 0, overBudget = 0;
+    for (const auto& item : items) {
+        if (!item.ok) {
+            failed++;
+            continue;
+        }
+        if (item.budget) {
+            budgeted++;
+            if (item.compressed > item.budget) overBudget++;
+        }
+        blocks.push_back({ item.offset, (size_t)item.compressed, (size_t)item.size });
+        totalOut += item.compressed;
+    }
+    std::sort(blocks.begin(), blocks.end());
+
+    std::filesystem::path manifestPath = std::filesystem::path(outDir) / manifestName;
+    std::ofstream out(manifestPath, std::ios::binary);
+    writeManifest(out, blocks, fmt, inDir, totalBytes);
+    out.close();
+    if (!out) {
+        std::cerr << "Erro: Falha ao gravar o manifesto: " << manifestPath.string() << std::endl;
+        return false;
+    }
+
+    std::cout << "Compressao concluida: " << blocks.size() << " blocos OK, " << failed << " Falhas";
+    if (ignored) std::cout << ", " << ignored << " arquivos ignorados (nome fora do padrao)";
+    std::cout << ". " << totalBytes << " -> " << totalOut << " bytes em " << std::fixed << std::setprecision(2)
+        << secs << "s com " << jobs << " threads, " << (emulate ? "encoder " + emulate->name() : "nivel " + std::to_string(level))
+        << std::defaultfloat << ".\n"
+        << "Manifesto: " << manifestPath.string() << std::endl;
+    if (!fitTo.empty()) {
+        std::cout << "Ajuste ao espaco original: " << budgeted - overBudget << " de " << budgeted
+            << " blocos cabem no lugar, " << overBudget << " maiores (serao realocados pelo --repack)";
+        if (budgeted < blocks.size()) std::cout << ", " << blocks.size() - budgeted << " fora do manifesto";
+        std::cout << "." << std::endl;
+    }
+    if (cache) {
+        std::cout << "Cache: " << cache->hits.load() << " acertos, " << cache->misses.load() << " faltas, "
+            << std::fixed << std::setprecision(2) << cache->savedNs.load() / 1e9 << std::defaultfloat
+            << "s de compressao economizados." << std::endl;
+    }
+    return failed == 0 && !cancelRequested();
+}
+
+// --- Verificação do Encoder Emulado (--verify-encoder) ---
+//
+// Para cada container: acha os blocos, infere o modelo do encoder numa
+// amostra espalhada pelo arquivo (ou usa o de --encoder) e recomprime
+// todos os blocos com ele, contando quantos saem idênticos ao original.
+
+const size_t kEncoderInferSample = 64;
+
+/**
+ * @brief Quantos blocos de 'sample' cada modelo reproduz, na ordem de
+ * encoderModelCandidates(). Os modelos são divididos entre 'jobs' threads.
+ */
+std::vector<size_t> rankEncoderModels(const std::vector<EncoderModel>& models,
+    const std::vector<std::pair<ByteView, std::vector<uint8_t>>>& sample, unsigned jobs) {
+    std::vector<size_t> hits(models.size(), 0);
+    std::atomic<size_t> next{ 0 };
+    auto worker = [&]() {
+        for (size_t m; (m = next.fetch_add(1)) < models.size() && !cancelRequested();) {
+            for (const auto& s : sample) {
+                std::vector<uint8_t> again = compressEmulated(s.second, models[m]);
+                if (again.size() == s.first.size() && std::equal(again.begin(), again.end(), s.first.data())) hits[m]++;
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < jobs; i++) threads.emplace_back(worker);
+    worker();
+    for (auto& t : threads) t.join();
+    return hits;
+}
+
+bool verifyEncoderFile(const std::string& path, const std::string& modelName, const ProcessOptions& opts) {
+    MappedFile input;
+    if (!input.open(path)) {
+        std::cerr << "Erro: Nao foi possivel abrir o arquivo de entrada: " << path << std::endl;
+        return false;
+    }
+    std::vector<ScanResult> blocks = scanContainer(input.view(), nullptr);
+    if (blocks.empty()) {
+        std::cout << path << ": nenhum bloco LZSS encontrado." << std::endl;
+        return true;
+    }
+    unsigned jobs = opts.jobs ? opts.jobs : std::max(1u, std::thread::hardware_concurrency());
+    auto blockView = [&](const ScanResult& b) { return ByteView(input.data() + b.offset, b.consumedSize); };
+
+    EncoderModel model;
+    if (!modelName.empty()) {
+        if (!parseEncoderModel(modelName, model)) {
+            std::cerr << "Erro: modelo de encoder desconhecido: " << modelName << std::endl;
+            return false;
+        }
+    }
+    else {
+        // Amostra espalhada pelo container inteiro; blocos que nem descomprimem ficam de fora.
+        std::vector<std::pair<ByteView, std::vector<uint8_t>>> sample;
+        size_t want = std::min(kEncoderInferSample, blocks.size());
+        for (size_t i = 0; i < want; i++) {
+            const ScanResult& b = blocks[i * blocks.size() / want];
+            try {
+                sample.emplace_back(blockView(b), decompressLZSSBlock(blockView(b)));
+            }
+            catch (const std::exception&) {
+            }
+        }
+        std::vector<EncoderModel> models = encoderModelCandidates();
+        std::vector<size_t> hits = rankEncoderModels(models, sample, jobs);
+        std::vector<size_t> order(models.size());
+        for (size_t i = 0; i < order.size(); i++) order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return hits[a] > hits[b]; });
+        model = models[order[0]];
+        size_t ties = (size_t)std::count(hits.begin(), hits.end(), hits[order[0]]);
+        std::cout << path << ": modelo inferido " << model.name() << " (" << hits[order[0]] << "/" << sample.size()
+            << " blocos da amostra";
+        if (ties > 1) std::cout << ", empatado com outros " << ties - 1 << "; a amostra nao distingue";
+        std::cout << ")" << std::endl;
+        for (size_t i = 1; i < std::min<size_t>(4, order.size()) && hits[order[i]] > 0; i++) {
+            std::cout << "  seguinte: " << models[order[i]].name() << " (" << hits[order[i]] << ")" << std::endl;
+        }
+    }
+
+    std::atomic<size_t> next{ 0 };
+    std::atomic<size_t> done{ 0 };
+    std::atomic<uint64_t> doneBytes{ 0 };
+    std::vector<uint8_t> same(blocks.size(), 0);
+    auto worker = [&]() {
+        for (size_t i; (i = next.fetch_add(1)) < blocks.size() && !cancelRequested();) {
+            ByteView original = blockView(blocks[i]);
+            try {
+                std::vector<uint8_t> again = compressEmulated(decompressLZSSBlock(original), model);
+                same[i] = again.size() == original.size() && std::equal(again.begin(), again.end(), original.data());
+            }
+            catch (const std::exception&) {
+            }
+            doneBytes += original.size();
+            done++;
+        }
+    };
+    uint64_t totalBytes = 0;
+    for (const auto& b : blocks) totalBytes += b.consumedSize;
+    ProgressReporter progress(opts.progressMode, opts.progressIntervalMs);
+    progress.begin("verify", totalBytes);
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < std::min<size_t>(jobs, blocks.size()); i++) threads.emplace_back(worker);
+    while (done.load() < blocks.size() && !cancelRequested()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(std::max(50u, opts.progressIntervalMs) / 5));
+        progress.tick(doneBytes.load(), blocks.size(), done.load());
+    }
+    for (auto& t : threads) t.join();
+    progress.end(doneBytes.load(), blocks.size(), done.load());
+
+    size_t matched = (size_t)std::count(same.begin(), same.end(), 1);
+    std::cout << path << ": " << matched << "/" << blocks.size() << " blocos (" << std::fixed << std::setprecision(1)
+        << 100.0 * matched / blocks.size() << std::defaultfloat << "%) reproduzidos byte a byte com " << model.name() << std::endl;
+    if (matched < blocks.size()) {
+        std::cout << "  Primeiros diferentes:";
+        for (size_t i = 0, shown = 0; i < blocks.size() && shown < 5; i++) {
+            if (same[i]) continue;
+            std::cout << " 0x" << std::hex << blocks[i].offset << std::dec;
+            shown++;
+        }
+        std::cout << std::endl;
+    }
+    return !cancelRequested();
+}
+
+// --- Verificação de Ida e Volta (--verify) ---
+//
+// Prova, antes de distribuir um container, que todo bloco sobrevive ao
+// ciclo completo: descomprime, recomprime com o nível (ou --encoder)
+// escolhido, descomprime de novo e compara os XXH64 das duas saídas. Os
+// blocos vão para o pool em grupos de ~kBatchExtractBytes comprimidos.
+
+struct RoundTripTally {
+    std::atomic<size_t> blocks{ 0 };
+    std::atomic<size_t> failed{ 0 };
+    std::atomic<size_t> larger{ 0 };
+    std::atomic<size_t> smaller{ 0 };
+    std::atomic<uint64_t> inputBytes{ 0 };    // comprimidos, do container
+    std::atomic<uint64_t> decodedBytes{ 0 };
+    std::atomic<uint64_t> recompressedBytes{ 0 };
+    std::mutex mutex;
+    std::vector<std::pair<uint64_t, std::string>> failures; // offset, motivo
+};
+
+static void roundTripBlock(ByteView original, uint64_t offset, int level, const EncoderModel* emulate, RoundTripTally& t) {
+    std::string reason;
+    try {
+        XXH64 first, second;
+        std::vector<uint8_t> data = decompressLZSSBlock(original, &first);
+        std::vector<uint8_t> again = emulate ? compressEmulated(data, *emulate) : compressLZSSBlock(data, level);
+        std::vector<uint8_t> back;
+        try {
+            back = decompressLZSSBlock(again, &second);
+        }
+        catch (const std::exception& e) {
+            reason = std::string("bloco recomprimido invalido: ") + e.what();
+        }
+        if (reason.empty() && (back.size() != data.size() || second.digest() != first.digest())) {
+            reason = "saida diferente depois de recomprimir";
+        }
+        t.decodedBytes += data.size();
+        t.recompressedBytes += again.size();
+        if (again.size() > original.size()) t.larger++;
+        else if (again.size() < original.size()) t.smaller++;
+    }
+    catch (const std::exception& e) {
+        reason = std::string("bloco original nao descomprime: ") + e.what();
+    }
+    t.inputBytes += original.size();
+    t.blocks++;
+    if (!reason.empty()) {
+        t.failed++;
+        std::lock_guard<std::mutex> lock(t.mutex);
+        t.failures.emplace_back(offset, reason);
+    }
+}
+
+bool verifyRoundTripFile(const std::string& path, int level, const EncoderModel* emulate, WorkStealingPool& pool,
+    const ProcessOptions& opts) {
+    MappedFile input;
+    if (!input.open(path)) {
+        std::cerr << "Erro: Nao foi possivel abrir o arquivo de entrada: " << path << std::endl;
+        return false;
+    }
+    std::vector<ScanResult> blocks = input.empty() ? std::vector<ScanResult>() : scanContainer(input.view(), nullptr);
+    if (cancelRequested()) return false;
+    uint64_t totalBytes = 0;
+    for (const auto& b : blocks) totalBytes += b.consumedSize;
+
+    RoundTripTally tally;
+    auto t0 = std::chrono::steady_clock::now();
+    ProgressReporter progress(opts.progressMode, opts.progressIntervalMs);
+    progress.begin("verify", totalBytes);
+    for (size_t first = 0; first < blocks.size();) {
+        size_t last = first, bytes = 0;
+        while (last < blocks.size() && (last == first || bytes < kBatchExtractBytes)) bytes += blocks[last++].consumedSize;
+        pool.submit([&, first, last] {
+            for (size_t i = first; i < last && !cancelRequested(); i++) {
+                roundTripBlock(ByteView(input.data() + blocks[i].offset, blocks[i].consumedSize), blocks[i].offset,
+                    level, emulate, tally);
+            }
+        });
+        first = last;
+    }
+    auto interval = std::chrono::milliseconds(std::max(50u, opts.progressIntervalMs));
+    while (!pool.waitFor(interval)) progress.tick(tally.inputBytes.load(), blocks.size(), tally.blocks.load());
+    progress.end(tally.inputBytes.load(), blocks.size(), tally.blocks.load());
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    uint64_t in = tally.inputBytes.load(), out = tally.recompressedBytes.load();
+    double mb = tally.decodedBytes.load() / (1024.0 * 1024.0);
+    std::cout << path << ": " << tally.blocks.load() << " blocos, " << tally.failed.load() << " falhas, "
+        << (emulate ? "encoder " + emulate->name() : "nivel " + std::to_string(level)) << "\n"
+        << "  " << std::fixed << std::setprecision(1) << mb << " MB descomprimidos em " << std::setprecision(2) << secs
+        << "s (" << std::setprecision(1) << (secs > 0 ? mb / secs : 0.0) << " MB/s, "
+        << (secs > 0 ? tally.blocks.load() / secs : 0.0) << " blocos/s)\n"
+        << "  Comprimido: " << in << " -> " << out << " bytes (" << std::showpos << (int64_t)(out - in) << ", "
+        << (in ? 100.0 * ((double)out - (double)in) / in : 0.0) << std::noshowpos << "%), " << tally.larger.load()
+        << " blocos maiores, " << tally.smaller.load() << " menores" << std::defaultfloat << std::endl;
+    std::sort(tally.failures.begin(), tally.failures.end());
+    for (size_t i = 0; i < tally.failures.size() && i < 10; i++) {
+        std::cout << "  FALHA 0x" << std::hex << tally.failures[i].first << std::dec << ": " << tally.failures[i].second << std::endl;
+    }
+    if (tally.failures.size() > 10) std::cout << "  ... e mais " << tally.failures.size() - 10 << " falhas" << std::endl;
+    return tally.failed.load() == 0 && !cancelRequested();
+}
+
+// --- Reinserção no Container (--repack) ---
+//
+// Grava no próprio container os blocos gerados pelo --compress-dir, sem
+// copiar nem reescrever o resto da imagem: só os bytes dos blocos alterados
+// são tocados, por isso editar um arquivo numa imagem de 4 GB leva
+// milissegundos. Um bloco que cabe no espaço original (consumedSize do
+// manifesto) é gravado no lugar e a sobra é zerada. Um bloco que cresceu
+// libera o espaço antigo e vai para o menor buraco livre que o comporte
+// (só contam como livres os espaços de blocos liberados e as sobras; o que
+// está entre blocos no container não é nosso) ou para o fim do arquivo.
+// Blocos que mudaram de lugar ficam listados em <manifesto>.relocations.csv:
+// a tabela de arquivos do jogo precisa apontar para o offset novo.
+
+struct RepackSpan {
+    uint64_t start;
+    uint64_t end;
+};
+
+struct RepackRelocation {
+    uint64_t oldOffset;
+    uint64_t newOffset;
+    size_t consumedSize;
+};
+
+/**
+ * @brief Planejador do espaço livre do container: buracos indexados por
+ * tamanho para achar o menor que comporte um bloco (best-fit), respeitando
+ * o alinhamento do offset.
+ */
+class RepackSpacePlanner {
+public:
+    RepackSpacePlanner(uint64_t fileSize, uint64_t align) : end_(fileSize), align_(align) {}
+
+    void release(uint64_t start, uint64_t end) {
+        if (end > start) released_.push_back({ start, end });
+    }
+
+    // Junta os espaços vizinhos; chamar depois de todos os release() e antes do primeiro place().
+    void seal() {
+        std::sort(released_.begin(), released_.end(),
+            [](const RepackSpan& a, const RepackSpan& b) { return a.start < b.start; });
+        RepackSpan cur{ 0, 0 };
+        for (const auto& s : released_) {
+            if (cur.end > cur.start && s.start <= cur.end) {
+                cur.end = std::max(cur.end, s.end);
+                continue;
+            }
+            addFree(cur);
+            cur = s;
+        }
+        addFree(cur);
+        released_.clear();
+    }
+
+    // Retorna o offset escolhido; 'appended' diz se foi para o fim do arquivo.
+    uint64_t place(uint64_t size, bool& appended) {
+        for (auto it = free_.lower_bound(size); it != free_.end(); ++it) {
+            RepackSpan gap = it->second;
+            uint64_t at = alignUp(gap.start);
+            if (at + size > gap.end) continue;
+            free_.erase(it);
+            pad(gap.start, at);
+            addFree({ at + size, gap.end });
+            appended = false;
+            return at;
+        }
+        uint64_t at = alignUp(end_);
+        pad(end_, at);
+        end_ = at + size;
+        appended = true;
+        return at;
+    }
+
+    // Tudo que ficou sem dono e precisa ser zerado no container.
+    std::vector<RepackSpan> leftovers() const {
+        std::vector<RepackSpan> spans = padding_;
+        for (const auto& f : free_) spans.push_back(f.second);
+        return spans;
+    }
+
+    uint64_t fileEnd() const { return end_; }
+
+private:
+    uint64_t alignUp(uint64_t v) const { return (v + align_ - 1) / align_ * align_; }
+
+    void addFree(const RepackSpan& s) {
+        if (s.end > s.start) free_.insert({ s.end - s.start, s });
+    }
+
+    void pad(uint64_t start, uint64_t end) {
+        if (end > start) padding_.push_back({ start, end });
+    }
+
+    uint64_t end_;
+    uint64_t align_;
+    std::vector<RepackSpan> released_;
+    std::multimap<uint64_t, RepackSpan> free_; // tamanho -> buraco
+    std::vector<RepackSpan> padding_;
+};
+
+bool zeroFileRange(FileReader& file, uint64_t start, uint64_t end) {
+    static const std::vector<uint8_t> zeros(64 * 1024, 0);
+    while (start < end) {
+        size_t n = (size_t)std::min<uint64_t>(end - start, zeros.size());
+        if (!file.writeAt(start, zeros.data(), n)) return false;
+        start += n;
+    }
+    return true;
+}
+
+/**
+ * @brief Modo --repack: aplica no container os blocos de 'blocksDir'
+ * (saída do --compress-dir) e grava o manifesto atualizado em 'outManifest'.
+ * Com 'dryRun' só mostra o plano, sem gravar nada.
+ */
+bool repackContainer(const std::string& containerPath, const std::string& manifestPath, const std::string& blocksDir,
+    const std::string& outManifest, ManifestFormat fmt, uint64_t align, bool dryRun) {
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<ScanResult> blocks, edited;
+    std::filesystem::path editedManifest;
+    try {
+        blocks = readManifest(manifestPath);
+        for (const char* name : { "manifest.csv", "manifest.json", "manifest.twmf" }) {
+            std::filesystem::path p = std::filesystem::path(blocksDir) / name;
+            std::error_code ec;
+            if (std::filesystem::is_regular_file(p, ec)) {
+                editedManifest = p;
+                break;
+            }
+        }
+        if (editedManifest.empty()) {
+            std::cerr << "Erro: nenhum manifest.csv/json/twmf em " << blocksDir << " (gere com --compress-dir)" << std::endl;
+            return false;
+        }
+        edited = readManifest(editedManifest.string());
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Erro: " << e.what() << std::endl;
+        return false;
+    }
+    std::sort(blocks.begin(), blocks.end());
+
+    FileReader container;
+    if (!container.open(containerPath, !dryRun)) {
+        std::cerr << "Erro: Nao foi possivel abrir o container" << (dryRun ? "" : " para escrita") << ": "
+            << containerPath << std::endl;
+        return false;
+    }
+
+    struct Change {
+        size_t index;                // em 'blocks'
+        std::vector<uint8_t> data;   // bloco novo
+        uint64_t newOffset = 0;
+        bool appended = false;
+    };
+    std::vector<Change> inPlace, moved;
+    RepackSpacePlanner planner(container.size(), align);
+    size_t unchanged = 0, failed = 0;
+
+    // Um offset repetido no manifesto editado liberaria o mesmo espaço duas
+    // vezes no planejador: é erro, como um offset desconhecido.
+    std::vector<uint64_t> editedOffsets;
+    editedOffsets.reserve(edited.size());
+    for (const auto& e : edited) editedOffsets.push_back(e.offset);
+    std::sort(editedOffsets.begin(), editedOffsets.end());
+    std::unordered_set<uint64_t> duplicated;
+    for (size_t i = 1; i < editedOffsets.size(); i++) {
+        if (editedOffsets[i] == editedOffsets[i - 1] && duplicated.insert(editedOffsets[i]).second) {
+            std::cerr << "Erro: bloco 0x" << std::hex << editedOffsets[i] << std::dec
+                << " aparece mais de uma vez em " << editedManifest.string() << std::endl;
+            failed++;
+        }
+    }
+
+    for (const auto& e : edited) {
+        if (duplicated.count(e.offset)) continue;
+        auto it = std::lower_bound(blocks.begin(), blocks.end(), e.offset,
+            [](const ScanResult& b, uint64_t off) { return b.offset < off; });
+        if (it == blocks.end() || it->offset != e.offset) {
+            std::cerr << "Erro: bloco 0x" << std::hex << e.offset << std::dec
+                << " nao existe no manifesto original." << std::endl;
+            failed++;
+            continue;
+        }
+        Change c;
+        c.index = (size_t)(it - blocks.begin());
+        std::string blockPath = (std::filesystem::path(blocksDir) / compressedBlockName(e.offset)).string();
+        if (!readWholeFile(blockPath, c.data) || c.data.size() != e.consumedSize) {
+            std::cerr << "Erro: bloco ausente ou com tamanho diferente do manifesto: " << blockPath << std::endl;
+            failed++;
+            continue;
+        }
+
+        // Mesmo conteúdo descomprimido que o original: deixa o bloco antigo como está.
+        std::vector<uint8_t> original(it->consumedSize);
+        if (!container.readAt(it->offset, original.data(), original.size())) {
+            std::cerr << "Erro: Falha ao ler o bloco original 0x" << std::hex << it->offset << std::dec << std::endl;
+            failed++;
+            continue;
+        }
+        try {
+            std::vector<uint8_t> fresh = decompressLZSSBlock(c.data);
+            if (fresh.size() != e.decompressedSize) throw std::runtime_error("tamanho descomprimido diferente do manifesto");
+            if (c.data == original || fresh == decompressLZSSBlock(original)) {
+                unchanged++;
+                continue;
+            }
+            it->decompressedSize = fresh.size();
+        }
+        catch (const std::exception& ex) {
+            std::cerr << "Erro: bloco invalido " << blockPath << ": " << ex.what() << std::endl;
+            failed++;
+            continue;
+        }
+
+        if (c.data.size() <= it->consumedSize) {
+            planner.release(it->offset + c.data.size(), it->offset + it->consumedSize);
+            inPlace.push_back(std::move(c));
+        }
+        else {
+            planner.release(it->offset, it->offset + it->consumedSize);
+            moved.push_back(std::move(c));
+        }
+    }
+    if (failed) {
+        std::cerr << "Nada foi gravado: " << failed << " bloco(s) com erro." << std::endl;
+        return false;
+    }
+
+    // Maiores primeiro: são os que têm menos buracos onde caber.
+    planner.seal();
+    std::stable_sort(moved.begin(), moved.end(),
+        [](const Change& a, const Change& b) { return a.data.size() > b.data.size(); });
+    size_t appended = 0;
+    for (auto& c : moved) {
+        c.newOffset = planner.place(c.data.size(), c.appended);
+        if (c.appended) appended++;
+    }
+
+    uint64_t written = 0;
+    if (!dryRun) {
+        bool ok = true;
+        for (const auto& s : planner.leftovers()) {
+            ok = ok && zeroFileRange(container, s.start, s.end);
+            written += s.end - s.start;
+        }
+        for (const auto& c : inPlace) {
+            ok = ok && container.writeAt(blocks[c.index].offset, c.data.data(), c.data.size());
+            written += c.data.size();
+        }
+        for (const auto& c : moved) {
+            ok = ok && container.writeAt(c.newOffset, c.data.data(), c.data.size());
+            written += c.data.size();
+        }
+        if (!ok) {
+            std::cerr << "Erro: Falha ao gravar no container: " << containerPath
+                << " (o container pode ter ficado parcialmente atualizado)" << std::endl;
+            return false;
+        }
+    }
+    container.close();
+
+    std::vector<RepackRelocation> relocations;
+    for (const auto& c : inPlace) blocks[c.index].consumedSize = c.data.size();
+    for (const auto& c : moved) {
+        ScanResult& b = blocks[c.index];
+        relocations.push_back({ b.offset, c.newOffset, c.data.size() });
+        b.offset = c.newOffset;
+        b.consumedSize = c.data.size();
+    }
+    std::sort(blocks.begin(), blocks.end());
+    std::sort(relocations.begin(), relocations.end(),
+        [](const RepackRelocation& a, const RepackRelocation& b) { return a.oldOffset < b.oldOffset; });
+
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << (dryRun ? "Plano (--dry-run, nada gravado): " : "Reinsercao concluida: ")
+        << inPlace.size() << " no lugar, " << moved.size() - appended << " realocados em espaco livre, "
+        << appended << " no fim do arquivo, " << unchanged << " inalterados. " << written
+        << " bytes gravados em " << std::fixed << std::setprecision(3) << secs << "s" << std::defaultfloat << ".\n";
+    for (const auto& r : relocations) {
+        std::cout << "  Bloco 0x" << std::hex << std::setfill('0') << std::setw(8) << r.oldOffset << " -> 0x"
+            << std::setw(8) << r.newOffset << std::dec << std::setfill(' ') << " (" << r.consumedSize
+            << " bytes)\n";
+    }
+    if (dryRun) return true;
+
+    std::ofstream out(outManifest, std::ios::binary);
+    writeManifest(out, blocks, fmt, containerPath, planner.fileEnd());
+    out.close();
+    if (!out) {
+        std::cerr << "Erro: Falha ao gravar o manifesto: " << outManifest << std::endl;
+        return false;
+    }
+    std::cout << "Manifesto atualizado: " << outManifest << std::endl;
+    if (!relocations.empty()) {
+        std::string relPath = outManifest + ".relocations.csv";
+        std::ofstream rel(relPath, std::ios::binary);
+        rel << "old_offset,new_offset,consumed\n";
+        for (const auto& r : relocations) rel << r.oldOffset << "," << r.newOffset << "," << r.consumedSize << "\n";
+        rel.close();
+        if (!rel) {
+            std::cerr << "Erro: Falha ao gravar " << relPath << std::endl;
+            return false;
+        }
+        std::cout << "Realocacoes: " << relPath << " (atualize a tabela de arquivos do jogo)" << std::endl;
+    }
+    return true;
+}
+
+// --- Patch Delta entre Versões (--diff / --apply) ---
+//
+// Distribuir uma tradução como containers inteiros custa gigabytes. O
+// --diff escaneia o container original e o modificado e grava só o que
+// mudou: cada bloco LZSS do modificado é procurado primeiro na mesma
+// posição do original (igual = nada a fazer), depois pelo XXH64 dos bytes
+// comprimidos em qualquer posição do original (vira uma cópia, sem dados);
+// se não existir, vai o bloco novo ou, se poucos bytes mudaram, só eles.
+// As regiões fora de blocos são comparadas byte a byte com a mesma
+// posição do original. Layout (little-endian):
+//
+//   "TWDP" u32 versão u64 tamanho original u64 tamanho novo u64 contagem
+//   u64 XXH64 dos bytes do original que o patch lê ou sobrescreve  (40 bytes)
+//   contagem * { u32 tipo, u64 destino, u64 tamanho, u64 origem } (28 bytes)
+//       seguidos de 'tamanho' bytes nos tipos com dados
+//   u64 XXH64 de tudo que vem antes                                (rodapé)
+//
+// O --apply grava no próprio original, como o --repack: primeiro confere o
+// patch e os bytes do original que ele vai tocar (nada é gravado se algo
+// não bater), depois grava só as faixas dos registros.
+
+static const char kPatchMagic[4] = { 'T', 'W', 'D', 'P' };
+static const uint32_t kPatchVersion = 1;
+static const size_t kPatchRecordHeader = 28;
+
+enum class PatchRecordType : uint32_t {
+    Block = 1, // Bloco LZSS novo ou alterado (com dados)
+    Copy = 2,  // Bloco que já existe em outra posição do original (sem dados)
+    Raw = 3,   // Bytes alterados fora de blocos, ou poucos bytes dentro de um bloco (com dados)
+};
+
+struct PatchRecord {
+    PatchRecordType type;
+    uint64_t dst;
+    uint64_t len;
+    uint64_t src = 0;           // Só Copy
+    const uint8_t* data = nullptr; // Block/Raw: aponta para o container modificado
+};
+
+/**
+ * @brief Faixas de 'mod' diferentes de 'orig' (que tem só 'origAvail'
+ * bytes; o resto conta como diferente). Trechos iguais menores que o
+ * cabeçalho de um registro não compensam um registro novo e ficam dentro.
+ */
+static void appendByteDelta(const uint8_t* orig, size_t origAvail, const uint8_t* mod, size_t len, uint64_t base,
+    std::vector<PatchRecord>& out) {
+    size_t i = 0;
+    while (i < len) {
+        while (i < len && i < origAvail && orig[i] == mod[i]) i++;
+        if (i == len) break;
+        size_t start = i, end = i;
+        while (i < len) {
+            if (i >= origAvail || orig[i] != mod[i]) {
+                end = ++i;
+                continue;
+            }
+            size_t same = i;
+            while (same < len && same < origAvail && orig[same] == mod[same] && same - i < kPatchRecordHeader) same++;
+            if (same == len || same - i >= kPatchRecordHeader) break;
+            i = same;
+        }
+        out.push_back({ PatchRecordType::Raw, base + start, end - start, 0, mod + start });
+        i = end;
+    }
+}
+
+bool diffContainers(const std::string& origPath, const std::string& modPath, const std::string& patchPath) {
+    auto t0 = std::chrono::steady_clock::now();
+    MappedFile orig, mod;
+    for (const auto& f : { std::make_pair(&orig, &origPath), std::make_pair(&mod, &modPath) }) {
+        if (!f.first->open(*f.second)) {
+            std::cerr << "Erro: Nao foi possivel abrir o arquivo de entrada: " << *f.second << std::endl;
+            return false;
+        }
+    }
+    std::vector<ScanResult> origBlocks = orig.empty() ? std::vector<ScanResult>() : scanContainer(orig.view(), nullptr);
+    std::vector<ScanResult> modBlocks = mod.empty() ? std::vector<ScanResult>() : scanContainer(mod.view(), nullptr);
+    if (cancelRequested()) return false;
+
+    std::unordered_map<uint64_t, uint64_t> origByRaw; // XXH64 dos bytes comprimidos -> offset no original
+    for (const auto& b : origBlocks) {
+        origByRaw.emplace(ChunkStore::rawKey(ByteView(orig.data() + b.offset, b.consumedSize)), b.offset);
+    }
+
+    std::vector<PatchRecord> records;
+    size_t unchanged = 0, copied = 0, replaced = 0, patchedBlocks = 0;
+    auto origAvail = [&](uint64_t at) { return at < orig.size() ? (size_t)(orig.size() - at) : (size_t)0; };
+    auto gap = [&](uint64_t from, uint64_t to) {
+        if (to > from) appendByteDelta(orig.data() + std::min<uint64_t>(from, orig.size()), origAvail(from),
+            mod.data() + from, (size_t)(to - from), from, records);
+    };
+    uint64_t pos = 0;
+    for (const auto& b : modBlocks) {
+        if (b.offset < pos) continue; // Sobreposto ao anterior: já coberto
+        gap(pos, b.offset);
+        pos = b.offset + b.consumedSize;
+        const uint8_t* bytes = mod.data() + b.offset;
+        size_t avail = origAvail(b.offset);
+        if (avail >= b.consumedSize && std::memcmp(orig.data() + b.offset, bytes, b.consumedSize) == 0) {
+            unchanged++;
+            continue;
+        }
+        auto it = origByRaw.find(ChunkStore::rawKey(ByteView(bytes, b.consumedSize)));
+        if (it != origByRaw.end() && std::memcmp(orig.data() + it->second, bytes, b.consumedSize) == 0) {
+            records.push_back({ PatchRecordType::Copy, b.offset, b.consumedSize, it->second });
+            copied++;
+            continue;
+        }
+        // Bloco alterado: só os bytes diferentes, se isso sair menor que o bloco inteiro.
+        std::vector<PatchRecord> delta;
+        appendByteDelta(orig.data() + std::min<uint64_t>(b.offset, orig.size()), avail, bytes, b.consumedSize,
+            b.offset, delta);
+        size_t deltaCost = 0;
+        for (const auto& r : delta) deltaCost += kPatchRecordHeader + (size_t)r.len;
+        if (deltaCost < kPatchRecordHeader + b.consumedSize) {
+            records.insert(records.end(), delta.begin(), delta.end());
+            patchedBlocks++;
+        }
+        else {
+            records.push_back({ PatchRecordType::Block, b.offset, b.consumedSize, 0, bytes });
+            replaced++;
+        }
+    }
+    gap(pos, mod.size());
+
+    // Bytes do original que o --apply vai ler ou sobrescrever: conferidos antes de gravar qualquer coisa.
+    XXH64 check;
+    for (const auto& r : records) {
+        if (r.dst < orig.size()) check.update(orig.data() + r.dst, (size_t)std::min<uint64_t>(r.len, orig.size() - r.dst));
+        if (r.type == PatchRecordType::Copy) check.update(orig.data() + r.src, (size_t)r.len);
+    }
+
+    std::ofstream out(patchPath, std::ios::binary);
+    if (!out) {
+        std::cerr << "Erro: Nao foi possivel criar o patch: " << patchPath << std::endl;
+        return false;
+    }
+    XXH64 body;
+    uint64_t patchSize = 0, rawBytes = 0, blockBytes = 0;
+    auto put = [&](const void* p, size_t n) {
+        out.write(static_cast<const char*>(p), (std::streamsize)n);
+        body.update(static_cast<const uint8_t*>(p), n);
+        patchSize += n;
+    };
+    auto put32 = [&](uint32_t v) { uint8_t b[4]; for (int i = 0; i < 4; i++) b[i] = (uint8_t)(v >> (8 * i)); put(b, 4); };
+    auto put64 = [&](uint64_t v) { uint8_t b[8]; for (int i = 0; i < 8; i++) b[i] = (uint8_t)(v >> (8 * i)); put(b, 8); };
+    put(kPatchMagic, 4);
+    put32(kPatchVersion);
+    put64(orig.size());
+    put64(mod.size());
+    put64(records.size());
+    put64(check.digest());
+    for (const auto& r : records) {
+        put32((uint32_t)r.type);
+        put64(r.dst);
+        put64(r.len);
+        put64(r.src);
+        if (r.type == PatchRecordType::Copy) continue;
+        put(r.data, (size_t)r.len);
+        (r.type == PatchRecordType::Raw ? rawBytes : blockBytes) += r.len;
+    }
+    writeLE(out, body.digest());
+    patchSize += 8;
+    out.close();
+    if (!out) {
+        std::cerr << "Erro: Falha ao gravar o patch: " << patchPath << std::endl;
+        return false;
+    }
+
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << "Patch gravado em: " << patchPath << " (" << patchSize << " bytes, " << std::fixed << std::setprecision(2)
+        << (mod.size() ? 100.0 * patchSize / mod.size() : 0.0) << "% do modificado, " << secs << "s)" << std::defaultfloat << "\n"
+        << "  Blocos: " << unchanged << " iguais, " << copied << " movidos (copia do original), " << replaced
+        << " novos (" << blockBytes << " bytes), " << patchedBlocks << " com poucos bytes alterados\n"
+        << "  Bytes crus (fora de blocos ou dentro dos alterados): " << rawBytes << std::endl;
+    return true;
+}
+
+/**
+ * @brief Modo --apply: confere e aplica um patch do --diff no próprio
+ * container original. Com 'dryRun' só confere.
+ */
+bool applyPatch(const std::string& containerPath, const std::string& patchPath, bool dryRun) {
+    auto t0 = std::chrono::steady_clock::now();
+    std::ifstream in(patchPath, std::ios::binary);
+    if (!in) {
+        std::cerr << "Erro: Nao foi possivel abrir o patch: " << patchPath << std::endl;
+        return false;
+    }
+    FileReader container;
+    if (!container.open(containerPath, !dryRun)) {
+        std::cerr << "Erro: Nao foi possivel abrir o container" << (dryRun ? "" : " para escrita") << ": "
+            << containerPath << std::endl;
+        return false;
+    }
+
+    uint8_t head[40];
+    in.read(reinterpret_cast<char*>(head), sizeof(head));
+    auto get64 = [](const uint8_t* p) { uint64_t v = 0; for (int k = 0; k < 8; k++) v |= (uint64_t)p[k] << (8 * k); return v; };
+    uint32_t version = (uint32_t)get64(head + 4);
+    uint64_t origSize = get64(head + 8), newSize = get64(head + 16), count = get64(head + 24), expectedCheck = get64(head + 32);
+    if (!in || !std::equal(head, head + 4, kPatchMagic) || version != kPatchVersion) {
+        std::cerr << "Erro: " << patchPath << " nao e um patch do --diff (versao " << kPatchVersion << ")." << std::endl;
+        return false;
+    }
+    if (container.size() != origSize) {
+        std::cerr << "Erro: o container tem " << container.size() << " bytes; o patch e para um de " << origSize
+            << " (ja aplicado, ou outra versao?). Nada foi gravado." << std::endl;
+        return false;
+    }
+
+    // Passada 1: integridade do patch, bytes do original que ele toca e
+    // registros, sem os dados. Cópias cuja origem vai ser sobrescrita por
+    // outro registro são lidas agora, antes de qualquer gravação.
+    struct Header {
+        PatchRecordType type;
+        uint64_t dst, len, src;
+        std::streamoff data;
+    };
+    std::vector<Header> headers;
+    headers.reserve((size_t)std::min<uint64_t>(count, 1u << 20));
+    XXH64 body, check;
+    body.update(head, sizeof(head));
+    std::vector<uint8_t> buf(1 << 20);
+    bool ok = true;
+    for (uint64_t i = 0; i < count && ok; i++) {
+        uint8_t rec[kPatchRecordHeader];
+        in.read(reinterpret_cast<char*>(rec), sizeof(rec));
+        if (!in) {
+            ok = false;
+            break;
+        }
+        body.update(rec, sizeof(rec));
+        Header h{ (PatchRecordType)(uint32_t)get64(rec), get64(rec + 4), get64(rec + 12), get64(rec + 20), in.tellg() };
+        if (h.type != PatchRecordType::Block && h.type != PatchRecordType::Copy && h.type != PatchRecordType::Raw) {
+            ok = false;
+            break;
+        }
+        // Destino dentro da versão nova e origem das cópias dentro do
+        // original, sem somar (um len absurdo não pode dar a volta).
+        if (h.len > newSize || h.dst > newSize - h.len
+            || (h.type == PatchRecordType::Copy && (h.len > origSize || h.src > origSize - h.len))) {
+            ok = false;
+            break;
+        }
+        if (h.type != PatchRecordType::Copy) {
+            for (uint64_t left = h.len; left > 0 && ok;) {
+                size_t n = (size_t)std::min<uint64_t>(left, buf.size());
+                in.read(reinterpret_cast<char*>(buf.data()), (std::streamsize)n);
+                ok = (bool)in;
+                body.update(buf.data(), n);
+                left -= n;
+            }
+        }
+        headers.push_back(h);
+    }
+    uint64_t expectedBody = 0;
+    if (!ok || !readLE(in, expectedBody) || expectedBody != body.digest()) {
+        std::cerr << "Erro: patch truncado ou corrompido: " << patchPath << ". Nada foi gravado." << std::endl;
+        return false;
+    }
+
+    // Os registros do --diff vêm em ordem de destino e não se sobrepõem.
+    std::vector<RepackSpan> writes;
+    for (const auto& h : headers) writes.push_back({ h.dst, h.dst + h.len });
+    if (std::adjacent_find(writes.begin(), writes.end(),
+        [](const RepackSpan& a, const RepackSpan& b) { return b.start < a.end; }) != writes.end()) {
+        std::cerr << "Erro: registros do patch fora de ordem: " << patchPath << ". Nada foi gravado." << std::endl;
+        return false;
+    }
+    auto overwritten = [&](uint64_t start, uint64_t end) {
+        auto it = std::upper_bound(writes.begin(), writes.end(), start, [](uint64_t v, const RepackSpan& s) { return v < s.end; });
+        return it != writes.end() && it->start < end;
+    };
+    std::unordered_map<size_t, std::vector<uint8_t>> savedSources; // índice do registro -> bytes da origem
+    for (size_t i = 0; i < headers.size() && ok; i++) {
+        const Header& h = headers[i];
+        for (uint64_t at = h.dst; at < std::min(h.dst + h.len, origSize) && ok;) {
+            size_t n = (size_t)std::min<uint64_t>(std::min(h.dst + h.len, origSize) - at, buf.size());
+            ok = container.readAt(at, buf.data(), n);
+            check.update(buf.data(), n);
+            at += n;
+        }
+        if (ok && h.type == PatchRecordType::Copy) {
+            std::vector<uint8_t> source((size_t)h.len);
+            ok = container.readAt(h.src, source.data(), source.size());
+            check.update(source.data(), source.size());
+            if (overwritten(h.src, h.src + h.len)) savedSources[i] = std::move(source);
+        }
+    }
+    if (!ok || check.digest() != expectedCheck) {
+        std::cerr << "Erro: o container nao e o original deste patch (os bytes que ele altera nao conferem). "
+            "Nada foi gravado." << std::endl;
+        return false;
+    }
+
+    uint64_t written = 0;
+    size_t blocks = 0, copies = 0, raws = 0;
+    for (const auto& h : headers) {
+        (h.type == PatchRecordType::Block ? blocks : h.type == PatchRecordType::Copy ? copies : raws)++;
+        written += h.len;
+    }
+    if (!dryRun) {
+        // Passada 2: cópias (origens sobrescritas já estão na memória), depois os dados do patch.
+        for (size_t i = 0; i < headers.size() && ok; i++) {
+            const Header& h = headers[i];
+            if (h.type != PatchRecordType::Copy) continue;
+            auto saved = savedSources.find(i);
+            std::vector<uint8_t> source;
+            if (saved == savedSources.end()) {
+                source.resize((size_t)h.len);
+                ok = container.readAt(h.src, source.data(), source.size());
+            }
+            const std::vector<uint8_t>& bytes = saved == savedSources.end() ? source : saved->second;
+            ok = ok && container.writeAt(h.dst, bytes.data(), bytes.size());
+        }
+        for (const auto& h : headers) {
+            if (!ok) break;
+            if (h.type == PatchRecordType::Copy) continue;
+            in.clear();
+            in.seekg(h.data);
+            for (uint64_t done = 0; done < h.len && ok;) {
+                size_t n = (size_t)std::min<uint64_t>(h.len - done, buf.size());
+                in.read(reinterpret_cast<char*>(buf.data()), (std::streamsize)n);
+                ok = in && container.writeAt(h.dst + done, buf.data(), n);
+                done += n;
+            }
+        }
+        container.close();
+        std::error_code ec;
+        if (ok && newSize != origSize) std::filesystem::resize_file(containerPath, newSize, ec);
+        if (!ok || ec) {
+            std::cerr << "Erro: Falha ao gravar no container: " << containerPath
+                << " (o container pode ter ficado parcialmente atualizado)" << std::endl;
+            return false;
+        }
+    }
+
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << (dryRun ? "Patch confere (--dry-run, nada gravado): " : "Patch aplicado: ") << blocks << " blocos, "
+        << copies << " copias, " << raws << " trechos crus; " << written << (dryRun ? " bytes a gravar" : " bytes gravados") << ", tamanho final "
+        << newSize << " bytes, em " << std::fixed << std::setprecision(3) << secs << "s" << std::defaultfloat << "." << std::endl;
+    return true;
+}
+
+/**
+ * @brief Função principal
+ */
+int main(int argc, char* argv[]) {
+
+    // =========================================================
+    // MUDANÇA CRÍTICA: Forçar TUDO para UTF-8 (CP 65001)
+    // =========================================================
+#ifdef _WIN32
+    // Define o locale do C/C++ para UTF-8.
+    // Isso é importante para que o C++ (ex: fstream) 
+    // interprete corretamente os nomes de arquivo.
+    setlocale(LC_ALL, ".UTF8");
+
+    // Define a página de código de SAÍDA do console para 65001 (UTF-8)
+    // Isso faz com que 'std::cout' exiba 'ç', 'á', 'ã' corretamente.
+    SetConsoleOutputCP(CP_UTF8); // CP_UTF8 é um atalho para 65001
+
+    // Define a página de código de ENTRADA do console para 65001 (UTF-8)
+    // Isso afeta 'std::cin' e 'std::getline'.
+    SetConsoleCP(CP_UTF8);
+#endif
+    // =========================================================
+    // FIM DA MUDANÇA
+    // =========================================================
+
+
+    std::signal(SIGINT, onSigInt);
+
+    // Opções globais (--progress, ...) podem vir em qualquer posição;
+    // o resto dos argumentos segue os modos de sempre.
+    ProcessOptions opts;
+    std::string formatName;
+    uint32_t hashBlock = kDefaultHashBlock;
+    std::string outRoot; // --out-root (modo --batch)
+    int compressLevel = kDefaultCompressLevel; // --level
+    size_t budget = 0;        // --budget (modo --compress)
+    std::string fitManifest;  // --fit (modo --compress-dir)
+    std::string encoderName;  // --encoder (modos --compress, --compress-dir e --verify-encoder)
+    uint64_t repackAlign = 4; // --align (modo --repack)
+    bool dryRun = false;      // --dry-run (modo --repack)
+    TraceFileWriter traceOut; // --trace: grava ao sair de main(), por qualquer caminho
+    std::vector<std::string> args;
+    int i = 1;
+    // Valor numérico do flag 'a' (o próximo argumento), conferido contra a faixa.
+    auto numericFlag = [&](const std::string& a, uint64_t minValue, uint64_t maxValue, auto& out) {
+        uint64_t v = 0;
+        if (!parseUnsigned(argv[++i], minValue, maxValue, v)) {
+            std::cerr << "Erro: valor invalido para " << a << ": '" << argv[i] << "' (esperado um inteiro de "
+                << minValue << " a " << maxValue << ")." << std::endl;
+            return false;
+        }
+        out = static_cast<std::remove_reference_t<decltype(out)>>(v);
+        return true;
+    };
+    for (; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--progress" && i + 1 < argc) {
+            std::string m = argv[++i];
+            if (m == "console") opts.progressMode = ProgressMode::Console;
+            else if (m == "json") opts.progressMode = ProgressMode::Json;
+            else if (m == "none") opts.progressMode = ProgressMode::None;
+            else {
+                std::cerr << "Erro: modo de progresso desconhecido: " << m << std::endl;
+                return 1;
+            }
+        }
+        else if (a == "--progress-interval" && i + 1 < argc) {
+            if (!numericFlag(a, 0, UINT32_MAX, opts.progressIntervalMs)) return 1;
+        }
+        else if (a == "--format" && i + 1 < argc) {
+            formatName = argv[++i];
+        }
+        else if (a == "--hash-block" && i + 1 < argc) {
+            if (!numericFlag(a, 64, UINT32_MAX, hashBlock)) return 1;
+        }
+        else if (a == "--max-block" && i + 1 < argc) {
+            if (!numericFlag(a, 0, SIZE_MAX, opts.maxBlock)) return 1;
+        }
+        else if (a == "--writer" && i + 1 < argc) {
+            std::string w = argv[++i];
+            if (w == "auto") opts.writer.backend = WriterBackend::Auto;
+            else if (w == "sync") opts.writer.backend = WriterBackend::Sync;
+            else if (w == "threads") opts.writer.backend = WriterBackend::Threads;
+            else if (w == "uring") opts.writer.backend = WriterBackend::IoUring;
+            else {
+                std::cerr << "Erro: escritor desconhecido: " << w << std::endl;
+                return 1;
+            }
+        }
+        else if (a == "--writer-threads" && i + 1 < argc) {
+            if (!numericFlag(a, 0, 1024, opts.writer.threads)) return 1;
+        }
+        else if (a == "--queue-depth" && i + 1 < argc) {
+            if (!numericFlag(a, 0, SIZE_MAX, opts.writer.queueItems)) return 1;
+            opts.writer.queueItems = std::max<size_t>(1, opts.writer.queueItems);
+        }
+        else if (a == "--pack") {
+            opts.packOutput = true;
+        }
+        else if (a == "--dedup") {
+            opts.dedup = true;
+        }
+        else if (a == "--force") {
+            opts.skipUnchanged = false;
+        }
+        else if (a == "--window" && i + 1 < argc) {
+            // Em MB: o limite garante que a conversão para bytes não dá a volta.
+            if (!numericFlag(a, 1, SIZE_MAX / (1024 * 1024), opts.streamWindow)) return 1;
+            opts.streamWindow *= 1024 * 1024;
+        }
+        else if (a == "--jobs" && i + 1 < argc) {
+            if (!numericFlag(a, 0, 1024, opts.jobs)) return 1;
+        }
+        else if (a == "--trace" && i + 1 < argc) {
+            traceOut.path = argv[++i];
+            g_traceEnabled = true; // Antes de qualquer thread ser criado
+            traceThreadName("main");
+        }
+        else if (a == "--level" && i + 1 < argc) {
+            if (!numericFlag(a, 0, kMaxCompressLevel, compressLevel)) return 1;
+        }
+        else if (a == "--budget" && i + 1 < argc) {
+            if (!numericFlag(a, 0, SIZE_MAX, budget)) return 1;
+        }
+        else if (a == "--encoder" && i + 1 < argc) {
+            encoderName = argv[++i];
+        }
+        else if (a == "--fit" && i + 1 < argc) {
+            fitManifest = argv[++i];
+        }
+        else if (a == "--align" && i + 1 < argc) {
+            if (!numericFlag(a, 1, 1u << 30, repackAlign)) return 1;
+        }
+        else if (a == "--dry-run") {
+            dryRun = true;
+        }
+        else if (a == "--cache" && i + 1 < argc) {
+            opts.compressCache = argv[++i];
+        }
+        else if (a == "--no-cache") {
+            opts.useCompressCache = false;
+        }
+        else if (a == "--quiet") {
+            opts.quiet = true;
+        }
+        else if (a == "--out-root" && i + 1 < argc) {
+            outRoot = argv[++i];
+        }
+        else {
+            args.push_back(a);
+        }
+    }
+
+    // Compressão: --compress <entrada> <bloco> e --bench-compress <arquivo|diretorio>
+    EncoderModel encoderModel;
+    const EncoderModel* emulate = nullptr;
+    if (!encoderName.empty()) {
+        if (!parseEncoderModel(encoderName, encoderModel)) {
+            std::cerr << "Erro: modelo de encoder desconhecido: " << encoderName
+                << " (o --verify-encoder mostra o do container)" << std::endl;
+            return 1;
+        }
+        emulate = &encoderModel;
+    }
+    if (!args.empty() && args[0] == "--compress") {
+        if (args.size() != 3) {
+            std::cerr << "Uso: --compress <arquivo> <bloco_de_saida> [--level N] [--budget <bytes>]" << std::endl;
+            return 1;
+        }
+        return compressFile(args[1], args[2], compressLevel,
+            opts.jobs ? opts.jobs : std::max(1u, std::thread::hardware_concurrency()), budget, emulate) ? 0 : 1;
+    }
+    if (!args.empty() && args[0] == "--compress-dir") {
+        if (args.size() != 3) {
+            std::cerr << "Uso: --compress-dir <diretorio_de_chunks> <diretorio_de_saida> [--level N] [--jobs N] [--format csv|json|bin] [--cache <dir>|--no-cache] [--fit <manifesto_original>]" << std::endl;
+            return 1;
+        }
+        ManifestFormat fmt = ManifestFormat::Csv;
+        if (!formatName.empty() && !parseManifestFormat(formatName, fmt)) {
+            std::cerr << "Erro: formato de manifesto desconhecido: " << formatName << std::endl;
+            return 1;
+        }
+        const char* manifestName = fmt == ManifestFormat::Csv ? "manifest.csv"
+            : fmt == ManifestFormat::Json ? "manifest.json" : "manifest.twmf";
+        std::vector<ScanResult> fitTo;
+        if (!fitManifest.empty()) {
+            try {
+                fitTo = readManifest(fitManifest);
+            }
+            catch (const std::exception& e) {
+                std::cerr << "Erro: " << e.what() << std::endl;
+                return 1;
+            }
+            std::sort(fitTo.begin(), fitTo.end());
+        }
+        return compressDirectory(args[1], args[2], manifestName, fmt, compressLevel, opts, fitTo, emulate) ? 0 : 1;
+    }
+    if (!args.empty() && args[0] == "--verify") {
+        if (args.size() < 2) {
+            std::cerr << "Uso: --verify <container>... [--level N | --encoder <modelo>] [--jobs N]" << std::endl;
+            return 1;
+        }
+        WorkStealingPool pool(opts.jobs ? opts.jobs : std::max(1u, std::thread::hardware_concurrency()));
+        bool allOk = true;
+        for (size_t i = 1; i < args.size() && !cancelRequested(); i++) {
+            allOk = verifyRoundTripFile(args[i], compressLevel, emulate, pool, opts) && allOk;
+        }
+        return allOk ? 0 : 1;
+    }
+    if (!args.empty() && args[0] == "--verify-encoder") {
+        if (args.size() < 2) {
+            std::cerr << "Uso: --verify-encoder <container>... [--encoder <modelo>] [--jobs N]" << std::endl;
+            return 1;
+        }
+        bool allOk = true;
+        for (size_t i = 1; i < args.size() && !cancelRequested(); i++) {
+            allOk = verifyEncoderFile(args[i], encoderName, opts) && allOk;
+        }
+        return allOk ? 0 : 1;
+    }
+    if (!args.empty() && args[0] == "--diff") {
+        if (args.size() != 4) {
+            std::cerr << "Uso: --diff <container_original> <container_modificado> <patch_de_saida>" << std::endl;
+            return 1;
+        }
+        return diffContainers(args[1], args[2], args[3]) ? 0 : 1;
+    }
+    if (!args.empty() && args[0] == "--apply") {
+        if (args.size() != 3) {
+            std::cerr << "Uso: --apply <container_original> <patch> [--dry-run]" << std::endl;
+            return 1;
+        }
+        return applyPatch(args[1], args[2], dryRun) ? 0 : 1;
+    }
+    if (!args.empty() && args[0] == "--repack") {
+        if (args.size() != 5) {
+            std::cerr << "Uso: --repack <container> <manifesto_original> <diretorio_de_blocos> <manifesto_de_saida> [--align N] [--dry-run]" << std::endl;
+            return 1;
+        }
+        ManifestFormat fmt = manifestFormatFromPath(args[4]);
+        if (!formatName.empty() && !parseManifestFormat(formatName, fmt)) {
+            std::cerr << "Erro: formato de manifesto desconhecido: " << formatName << std::endl;
+            return 1;
+        }
+        return repackContainer(args[1], args[2], args[3], args[4], fmt, repackAlign, dryRun) ? 0 : 1;
+    }
+    if (!args.empty() && args[0] == "--bench-compress") {
+        if (args.size() != 2) {
+            std::cerr << "Uso: --bench-compress <arquivo|diretorio>" << std::endl;
+            return 1;
+        }
+        return benchCompress(args[1], opts.jobs ? opts.jobs : std::max(1u, std::thread::hardware_concurrency())) ? 0 : 1;
+    }
+
+    // Lote sem interação: --batch <diretorio|padrao|@lista|arquivo>...
+    // Sem pausa no final; o código de saída diz se tudo deu certo.
+    if (!args.empty() && args[0] == "--batch") {
+        std::vector<std::string> inputs;
+        bool listed = expandBatchInputs(std::vector<std::string>(args.begin() + 1, args.end()), inputs);
+        if (inputs.empty()) {
+            std::cerr << "Uso: --batch <diretorio|padrao|@lista.txt|container>... [--jobs N] [--quiet] [--out-root dir]" << std::endl;
+            return 1;
+        }
+        if (opts.packOutput || opts.dedup) {
+            std::cerr << "Aviso: --pack e --dedup nao se aplicam ao --batch; extraindo chunks soltos." << std::endl;
+            opts.packOutput = false;
+            opts.dedup = false;
+        }
+        g_logToStderr = true;
+        return BatchRunner(std::move(inputs), outRoot, opts).run() && listed ? 0 : 1;
+    }
+
+    // Modo somente-scan: --list <container> (CSV no stdout) ou
+    // --manifest <container> <saida> (formato pela extensão ou --format).
+    // Não há pausa no final: são modos para scripts.
+    if (!args.empty() && (args[0] == "--list" || args[0] == "--manifest")) {
+        bool toStdout = args[0] == "--list";
+        if (args.size() != (toStdout ? 2u : 3u)) {
+            std::cerr << "Uso: --list <container> | --manifest <container> <manifesto>" << std::endl;
+            return 1;
+        }
+        std::string manifestPath = toStdout ? "" : args[2];
+        ManifestFormat fmt = toStdout ? ManifestFormat::Csv : manifestFormatFromPath(manifestPath);
+        if (!formatName.empty() && !parseManifestFormat(formatName, fmt)) {
+            std::cerr << "Erro: formato de manifesto desconhecido: " << formatName << std::endl;
+            return 1;
+        }
+        if (toStdout && fmt == ManifestFormat::Binary) {
+            std::cerr << "Erro: use --manifest para o formato binario." << std::endl;
+            return 1;
+        }
+        g_logToStderr = toStdout;
+        return listContainerFile(args[1], manifestPath, fmt, opts) ? 0 : 1;
+    }
+
+    // Um bloco só, sem scan: --extract-at <offset> <container> [saida]
+    // (offset em decimal ou 0x...; sem saida, os bytes vão para o stdout).
+    if (!args.empty() && args[0] == "--extract-at") {
+        if (args.size() != 3 && args.size() != 4) {
+            std::cerr << "Uso: --extract-at <offset> <container|arquivo.twpk> [arquivo_de_saida]" << std::endl;
+            return 1;
+        }
+        uint64_t offset = 0;
+        if (!parseUnsigned(args[1], 0, UINT64_MAX, offset, 0)) {
+            std::cerr << "Erro: offset invalido: " << args[1] << std::endl;
+            return 1;
+        }
+        return extractBlockAt(args[2], offset, args.size() == 4 ? args[3] : "") ? 0 : 1;
+    }
+
+    // Re-scan incremental: --hashmap <container> <mapa> guarda o resumo da
+    // versão antiga; --rescan <antigo|mapa> <manifesto_antigo> <novo> <manifesto_novo>
+    // gera o manifesto da versão nova revalidando só o que mudou.
+    if (!args.empty() && args[0] == "--hashmap") {
+        if (args.size() != 3) {
+            std::cerr << "Uso: --hashmap <container> <mapa.twhm> [--hash-block N]" << std::endl;
+            return 1;
+        }
+        return hashMapContainerFile(args[1], args[2], hashBlock) ? 0 : 1;
+    }
+    if (!args.empty() && args[0] == "--rescan") {
+        if (args.size() != 5) {
+            std::cerr << "Uso: --rescan <container_antigo|mapa.twhm> <manifesto_antigo> <container_novo> <manifesto_novo>"
+                " [--max-block N] [--hash-block N]" << std::endl;
+            return 1;
+        }
+        ManifestFormat fmt = manifestFormatFromPath(args[4]);
+        if (!formatName.empty() && !parseManifestFormat(formatName, fmt)) {
+            std::cerr << "Erro: formato de manifesto desconhecido: " << formatName << std::endl;
+            return 1;
+        }
+        return rescanContainerFile(args[1], args[2], args[3], args[4], fmt, hashBlock, opts.maxBlock) ? 0 : 1;
+    }
+
+    // Pack -> arquivos soltos: --unpack <pack> <diretorio>
+    if (!args.empty() && args[0] == "--unpack") {
+        if (args.size() != 3) {
+            std::cerr << "Uso: --unpack <arquivo.twpk> <diretorio_de_saida>" << std::endl;
+            return 1;
+        }
+        return unpackFile(args[1], args[2], opts.writer) ? 0 : 1;
+    }
 
     // Modo: decompressor.exe -d <input_container> <output_directory>
-    if (argc == 4 && std::string(argv[1]) == "-d") {
-        std::string inPath = argv[2];
-        std::string outDir = argv[3];
-        processContainerFile(inPath, outDir);
+    if (args.size() == 3 && args[0] == "-d") {
+        std::string inPath = args[1];
+        std::string outDir = args[2];
+        processContainerFile(inPath, outDir, opts);
 
         // Modo: Arrastar e soltar (um ou mais arquivos) no .exe
     }
-    else if (argc > 1) {
-        for (int i = 1; i < argc; ++i) {
+    else if (!args.empty()) {
+        for (const auto& arg : args) {
             // Nota: Os 'argv' vêm do sistema. O setlocale acima
             // ajuda a 'std::filesystem::path' a entendê-los.
-            std::filesystem::path inPath(argv[i]);
-            std::string outDirName = inPath.filename().string() + "_decompressed";
+            std::filesystem::path inPath(arg);
+            std::string outDirName = inPath.filename().string() + (opts.packOutput ? "_decompressed.twpk" : "_decompressed");
             std::filesystem::path outDir = inPath.parent_path() / outDirName;
 
-            processContainerFile(inPath.string(), outDir.string());
+            processContainerFile(inPath.string(), outDir.string(), opts);
             std::cout << "---" << std::endl;
+            if (cancelRequested()) break;
         }
 
         // Modo: interativo (sem argumentos)
@@ -407,7 +4411,49 @@ int main(int argc, char* argv[]) {
         std::cout << "Uso:\n";
         std::cout << "  Modo 1: decompressor.exe -d <arquivo_de_entrada> <diretorio_de_saida>\n";
         std::cout << "  Modo 2: Arraste e solte um ou mais arquivos no .exe\n";
-        std::cout << "  Modo 3: Arraste um arquivo para esta janela e pressione Enter:\n" << std::endl;
+        std::cout << "  Modo 3: Arraste um arquivo para esta janela e pressione Enter:\n";
+        std::cout << "  Modo 4: decompressor.exe --list <arquivo>                 (lista blocos em CSV, sem extrair)\n";
+        std::cout << "  Modo 5: decompressor.exe --manifest <arquivo> <manifesto> (.json/.csv/.bin, sem extrair)\n";
+        std::cout << "  Modo 6: decompressor.exe --hashmap <arquivo> <mapa.twhm>  (resumo para re-scan incremental)\n";
+        std::cout << "  Modo 7: decompressor.exe --rescan <antigo|mapa.twhm> <manifesto_antigo> <novo> <manifesto_novo>\n";
+        std::cout << "  Modo 8: decompressor.exe --unpack <arquivo.twpk> <diretorio_de_saida>\n";
+        std::cout << "  Modo 9: decompressor.exe --extract-at <offset> <container|arquivo.twpk> [arquivo_de_saida]\n";
+        std::cout << "  Modo 10: decompressor.exe --batch <diretorio|padrao|@lista.txt|container>... (sem pausa)\n";
+        std::cout << "  Modo 11: decompressor.exe --compress <arquivo> <bloco_de_saida> [--level 0-10]\n";
+        std::cout << "  Modo 12: decompressor.exe --bench-compress <arquivo|diretorio>\n";
+        std::cout << "  Modo 13: decompressor.exe --compress-dir <diretorio_de_chunks> <diretorio_de_saida>\n";
+        std::cout << "  Modo 14: decompressor.exe --repack <container> <manifesto_original> <diretorio_de_blocos> <manifesto_de_saida>\n";
+        std::cout << "  Modo 15: decompressor.exe --verify-encoder <container>...  (% de blocos que o encoder emulado reproduz)\n";
+        std::cout << "  Modo 16: decompressor.exe --diff <original> <modificado> <patch>   (patch so com o que mudou)\n";
+        std::cout << "  Modo 17: decompressor.exe --apply <original> <patch>   (aplica no proprio original)\n";
+        std::cout << "  Modo 18: decompressor.exe --verify <container>...  (descomprime, recomprime e confere cada bloco)\n";
+        std::cout << "Opcoes:\n";
+        std::cout << "  --progress console|json|none   Relatorio de progresso no stderr (padrao: console)\n";
+        std::cout << "  --progress-interval <ms>       Intervalo entre atualizacoes (padrao: 500)\n";
+        std::cout << "  --format json|csv|bin          Formato do manifesto (padrao: pela extensao)\n";
+        std::cout << "  --hash-block <bytes>           Granularidade do mapa de hashes (padrao: 4096)\n";
+        std::cout << "  --max-block <bytes>            Maior bloco LZSS esperado (re-scan: o maior do manifesto antigo;\n";
+        std::cout << "                                 janelas: 16 MB de sobreposicao)\n";
+        std::cout << "  --window <MB>                  Scan em janelas (memoria limitada; automatico se nao couber)\n";
+        std::cout << "  --writer auto|sync|threads|uring  Estagio de escrita (padrao: auto = io_uring no Linux)\n";
+        std::cout << "  --writer-threads <n>           Threads do escritor em pool (padrao: 2)\n";
+        std::cout << "  --queue-depth <n>              Chunks na fila entre decodificacao e escrita (padrao: 256)\n";
+        std::cout << "  --level <0-10>                 Nivel do compressor (0 = so literais, 10 = parse otimo, padrao: 6)\n";
+        std::cout << "  --trace <arquivo.json>         Grava as fases da execucao (Chrome trace / Perfetto)\n";
+        std::cout << "  --jobs <n>                     Threads do --batch e da compressao (padrao: um por nucleo)\n";
+        std::cout << "  --quiet                        No --batch, mostra so erros e o resumo final\n";
+        std::cout << "  --out-root <dir>               No --batch, cria as pastas <nome>_decompressed aqui\n";
+        std::cout << "  --dedup                        Grava cada conteudo repetido uma vez (.store) e cria hardlinks\n";
+        std::cout << "  --encoder <modelo>             Comprime como o encoder original (ex: greedy-near-w4096-m2; ver --verify-encoder)\n";
+        std::cout << "  --budget <bytes>               No --compress, ajusta o bloco a esse tamanho maximo\n";
+        std::cout << "  --fit <manifesto>              No --compress-dir, ajusta cada bloco ao espaco original do container\n";
+        std::cout << "  --cache <dir>                  No --compress-dir, cache de blocos ja comprimidos (padrao: <saida>/.cache)\n";
+        std::cout << "  --no-cache                     No --compress-dir, comprime tudo sem usar o cache\n";
+        std::cout << "  --align <n>                    No --repack, alinhamento dos blocos realocados (padrao: 4)\n";
+        std::cout << "  --dry-run                      No --repack e no --apply, confere sem gravar no container\n";
+        std::cout << "  --force                        Regrava todos os chunks, mesmo os inalterados (no --compress-dir, ignora o cache)\n";
+        std::cout << "  --pack                         Extrai para um unico arquivo .twpk com indice (com -d, a saida e o arquivo)\n";
+        std::cout << "  Ctrl+C interrompe de forma limpa, mantendo o que ja foi extraido.\n" << std::endl;
 
         std::string filePath;
         std::getline(std::cin, filePath);
@@ -419,9 +4465,9 @@ int main(int argc, char* argv[]) {
 
         if (!filePath.empty()) {
             std::filesystem::path inPath(filePath);
-            std::string outDirName = inPath.filename().string() + "_decompressed";
+            std::string outDirName = inPath.filename().string() + (opts.packOutput ? "_decompressed.twpk" : "_decompressed");
             std::filesystem::path outDir = inPath.parent_path() / outDirName;
-            processContainerFile(inPath.string(), outDir.string());
+            processContainerFile(inPath.string(), outDir.string(), opts);
         }
         else {
             std::cout << "Nenhum arquivo para processar. Saindo." << std::endl;
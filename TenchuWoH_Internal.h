@@ -0,0 +1,629 @@
+// Parte interna do núcleo, fora do header público: includes de
+// plataforma, leitura do container (mapeamento / leitura em janelas),
+// progresso, cancelamento, log e trace da ferramenta, e o XXH64. Usado
+// pelo TenchuWoH_Core.cpp, pela API C e pela ferramenta de linha de
+// comando; não é instalado.
+
+#pragma once
+
+// Offsets de arquivo de 64 bits (pread/fstat) também em builds de 32 bits.
+// Precisa vir antes de qualquer include.
+#ifndef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <memory>
+#include <cerrno>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX     // Senão as macros min/max quebram std::min/std::max
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>    // open
+#include <sys/mman.h> // mmap / madvise
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // read / close
+#endif
+
+#include "TenchuWoH_Core.h"
+
+// --- Progresso e Cancelamento ---
+
+// Setada pelo handler de SIGINT (Ctrl+C) da ferramenta. Os loops de scan
+// e extração checam essa flag entre fatias/blocos e param de forma limpa,
+// mantendo tudo que já foi gravado em disco.
+inline std::atomic<bool> g_cancelRequested{ false };
+
+inline bool cancelRequested() {
+    return g_cancelRequested.load(std::memory_order_relaxed);
+}
+
+// Mensagens informativas vão para o stdout, exceto quando o próprio stdout
+// carrega dados (ex: --list), caso em que são desviadas para o stderr.
+inline bool g_logToStderr = false;
+
+inline std::ostream& logStream() {
+    return g_logToStderr ? std::cerr : std::cout;
+}
+
+enum class ProgressMode {
+    Console, // Linha única reescrita com '\r' no stderr
+    Json,    // Um evento JSON por linha no stderr (para ferramentas)
+    None
+};
+
+/**
+ * @brief Relatório periódico de progresso (bytes, candidatos, blocos, MB/s, ETA).
+ *
+ * O custo no loop quente é zero: quem chama só invoca tick() uma vez por
+ * fatia (scan) ou por bloco (extração), e tick() só lê o relógio e
+ * emite quando o intervalo configurado passou.
+ */
+class ProgressReporter {
+public:
+    ProgressReporter(ProgressMode mode, unsigned intervalMs)
+        : mode_(mode), interval_(intervalMs) {}
+
+    void begin(const char* phase, uint64_t totalBytes) {
+        phase_ = phase;
+        total_ = totalBytes;
+        start_ = std::chrono::steady_clock::now();
+        lastEmit_ = start_;
+        emitted_ = false;
+    }
+
+    // 'done' é medido na mesma unidade de 'totalBytes' passado em begin().
+    void tick(uint64_t done, uint64_t candidates, uint64_t blocks) {
+        if (mode_ == ProgressMode::None) return;
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastEmit_ < interval_) return;
+        lastEmit_ = now;
+        emit("progress", now, done, candidates, blocks);
+    }
+
+    void end(uint64_t done, uint64_t candidates, uint64_t blocks) {
+        if (mode_ == ProgressMode::None) return;
+        // No console só fecha a linha se algo foi mostrado; em JSON o
+        // evento final sempre sai para que ferramentas vejam o total.
+        if (mode_ == ProgressMode::Console && !emitted_) return;
+        emit(cancelRequested() ? "cancelled" : "done",
+            std::chrono::steady_clock::now(), done, candidates, blocks);
+        if (mode_ == ProgressMode::Console) std::cerr << std::endl;
+    }
+
+private:
+    void emit(const char* event, std::chrono::steady_clock::time_point now,
+        uint64_t done, uint64_t candidates, uint64_t blocks) {
+        double secs = std::chrono::duration<double>(now - start_).count();
+        double mbps = secs > 0 ? (done / (1024.0 * 1024.0)) / secs : 0.0;
+        double eta = (done > 0 && total_ > done) ? secs * (double)(total_ - done) / done : 0.0;
+        emitted_ = true;
+
+        if (mode_ == ProgressMode::Json) {
+            std::cerr << "{\"event\":\"" << event << "\",\"phase\":\"" << phase_
+                << "\",\"done\":" << done << ",\"total\":" << total_
+                << ",\"candidates\":" << candidates << ",\"blocks\":" << blocks
+                << std::fixed << std::setprecision(2)
+                << ",\"elapsed_s\":" << secs << ",\"mb_per_s\":" << mbps
+                << ",\"eta_s\":" << eta << "}" << std::defaultfloat << std::endl;
+            return;
+        }
+
+        double pct = total_ ? 100.0 * done / total_ : 100.0;
+        std::cerr << "\r[" << phase_ << "] " << std::fixed << std::setprecision(1)
+            << pct << "% (" << done / (1024 * 1024) << "/" << total_ / (1024 * 1024) << " MB)"
+            << " | candidatos: " << candidates << " | blocos: " << blocks
+            << " | " << mbps << " MB/s | ETA " << (uint64_t)eta << "s   "
+            << std::defaultfloat << std::flush;
+    }
+
+    ProgressMode mode_;
+    std::chrono::milliseconds interval_;
+    const char* phase_ = "";
+    uint64_t total_ = 0;
+    std::chrono::steady_clock::time_point start_, lastEmit_;
+    bool emitted_ = false;
+};
+
+// --- Rastreamento (--trace) ---
+//
+// Eventos com início e duração por fase (leitura, pré-filtro, validação,
+// dedup, decodificação, nomes, escrita), gravados no formato Chrome trace
+// para abrir no Perfetto (ui.perfetto.dev) ou em chrome://tracing. Cada
+// thread grava no seu próprio buffer, sem trava; a trava do registro só é
+// pega no primeiro evento de cada thread. Com o rastreamento desligado,
+// um TraceScope é só um teste de uma flag que nunca muda durante a execução.
+
+inline bool g_traceEnabled = false; // Setada em main() antes de qualquer thread
+
+struct TraceEvent {
+    const char* name;
+    uint64_t startNs;
+    uint64_t durNs;
+    const char* argName; // Opcional (nullptr = sem argumento)
+    uint64_t argValue;
+};
+
+struct TraceThreadBuffer {
+    unsigned tid = 0;
+    std::string name;
+    std::vector<TraceEvent> events;
+};
+
+class TraceRegistry {
+public:
+    static TraceRegistry& instance() {
+        static TraceRegistry registry;
+        return registry;
+    }
+
+    uint64_t now() const {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - origin_).count();
+    }
+
+    // Buffer do thread atual; os buffers vivem no registro, então os
+    // eventos de threads que já terminaram continuam disponíveis.
+    TraceThreadBuffer& local() {
+        thread_local TraceThreadBuffer* buffer = nullptr;
+        if (!buffer) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            buffers_.push_back(std::make_unique<TraceThreadBuffer>());
+            buffer = buffers_.back().get();
+            buffer->tid = (unsigned)buffers_.size();
+            buffer->events.reserve(4096);
+        }
+        return *buffer;
+    }
+
+    // Chamado no fim do programa, com os outros threads já encerrados.
+    bool write(const std::string& path) {
+        std::ofstream out(path, std::ios::binary);
+        if (!out) return false;
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        bool first = true;
+        auto sep = [&] { out << (first ? "" : ",\n"); first = false; };
+        out << std::fixed << std::setprecision(3);
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& b : buffers_) {
+            if (!b->name.empty()) {
+                sep();
+                out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << b->tid
+                    << ",\"args\":{\"name\":\"" << b->name << "\"}}";
+            }
+            for (const auto& e : b->events) {
+                sep();
+                out << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << b->tid
+                    << ",\"ts\":" << e.startNs / 1000.0 << ",\"dur\":" << e.durNs / 1000.0;
+                if (e.argName) out << ",\"args\":{\"" << e.argName << "\":" << e.argValue << "}";
+                out << "}";
+            }
+        }
+        out << "\n]}\n";
+        return (bool)out;
+    }
+
+private:
+    std::chrono::steady_clock::time_point origin_ = std::chrono::steady_clock::now();
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<TraceThreadBuffer>> buffers_;
+};
+
+inline uint64_t traceNow() {
+    return TraceRegistry::instance().now();
+}
+
+// Evento com tempos já medidos (ex.: a soma das validações de uma fatia).
+inline void traceEvent(const char* name, uint64_t startNs, uint64_t durNs, const char* argName = nullptr, uint64_t argValue = 0) {
+    if (!g_traceEnabled) return;
+    TraceRegistry::instance().local().events.push_back({ name, startNs, durNs, argName, argValue });
+}
+
+inline void traceThreadName(const std::string& name) {
+    if (!g_traceEnabled) return;
+    TraceRegistry::instance().local().name = name;
+}
+
+struct TraceFileWriter {
+    std::string path;
+    ~TraceFileWriter() {
+        if (path.empty()) return;
+        if (TraceRegistry::instance().write(path)) std::cerr << "Trace gravado em: " << path << std::endl;
+        else std::cerr << "Erro: Nao foi possivel gravar o trace: " << path << std::endl;
+    }
+};
+
+/**
+ * @brief Mede o escopo atual como um evento. 'name' deve ser um literal.
+ */
+class TraceScope {
+public:
+    explicit TraceScope(const char* name) : name_(name) {
+        if (g_traceEnabled) start_ = traceNow();
+    }
+    ~TraceScope() {
+        if (g_traceEnabled) traceEvent(name_, start_, traceNow() - start_, argName_, argValue_);
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    bool active() const { return g_traceEnabled; }
+    uint64_t start() const { return start_; }
+    void arg(const char* name, uint64_t value) {
+        argName_ = name;
+        argValue_ = value;
+    }
+
+private:
+    const char* name_;
+    uint64_t start_ = 0;
+    const char* argName_ = nullptr;
+    uint64_t argValue_ = 0;
+};
+
+// --- Hash Rápido (XXH64) ---
+//
+// Implementação direta do XXH64 (não criptográfico, ~GB/s). Usado para
+// identificar blocos/arquivos por conteúdo. A classe aceita dados em
+// pedaços (update) e dá o mesmo resultado que o hash de uma vez só.
+
+class XXH64 {
+public:
+    explicit XXH64(uint64_t seed = 0) : seed_(seed) {
+        v_[0] = seed + P1 + P2;
+        v_[1] = seed + P2;
+        v_[2] = seed;
+        v_[3] = seed - P1;
+    }
+
+    void update(const uint8_t* p, size_t len) {
+        total_ += len;
+        if (bufLen_ + len < 32) {
+            std::copy(p, p + len, buf_ + bufLen_);
+            bufLen_ += len;
+            return;
+        }
+        if (bufLen_) {
+            size_t fill = 32 - bufLen_;
+            std::copy(p, p + fill, buf_ + bufLen_);
+            stripe(buf_);
+            p += fill;
+            len -= fill;
+            bufLen_ = 0;
+        }
+        while (len >= 32) {
+            stripe(p);
+            p += 32;
+            len -= 32;
+        }
+        std::copy(p, p + len, buf_);
+        bufLen_ = len;
+    }
+
+    uint64_t digest() const {
+        uint64_t h;
+        if (total_ >= 32) {
+            h = rotl(v_[0], 1) + rotl(v_[1], 7) + rotl(v_[2], 12) + rotl(v_[3], 18);
+            for (int i = 0; i < 4; i++) h = (h ^ round(0, v_[i])) * P1 + P4;
+        }
+        else {
+            h = seed_ + P5;
+        }
+        h += total_;
+
+        const uint8_t* p = buf_;
+        size_t len = bufLen_;
+        for (; len >= 8; p += 8, len -= 8) h = rotl(h ^ round(0, read64(p)), 27) * P1 + P4;
+        if (len >= 4) {
+            h = rotl(h ^ (read32(p) * P1), 23) * P2 + P3;
+            p += 4;
+            len -= 4;
+        }
+        for (; len > 0; p++, len--) h = rotl(h ^ (*p * P5), 11) * P1;
+
+        h ^= h >> 33;
+        h *= P2;
+        h ^= h >> 29;
+        h *= P3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    static uint64_t hash(const uint8_t* p, size_t len, uint64_t seed = 0) {
+        XXH64 s(seed);
+        s.update(p, len);
+        return s.digest();
+    }
+
+private:
+    static constexpr uint64_t P1 = 11400714785074694791ULL;
+    static constexpr uint64_t P2 = 14029467366897019727ULL;
+    static constexpr uint64_t P3 = 1609587929392839161ULL;
+    static constexpr uint64_t P4 = 9650029242287828579ULL;
+    static constexpr uint64_t P5 = 2870177450012600261ULL;
+
+    static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+    static uint64_t read64(const uint8_t* p) {
+        uint64_t v = 0;
+        for (int i = 0; i < 8; i++) v |= (uint64_t)p[i] << (8 * i);
+        return v;
+    }
+    static uint64_t read32(const uint8_t* p) {
+        return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24);
+    }
+    static uint64_t round(uint64_t acc, uint64_t input) {
+        return rotl(acc + input * P2, 31) * P1;
+    }
+    void stripe(const uint8_t* p) {
+        for (int i = 0; i < 4; i++) v_[i] = round(v_[i], read64(p + 8 * i));
+    }
+
+    uint64_t seed_;
+    uint64_t v_[4];
+    uint8_t buf_[32];
+    size_t bufLen_ = 0;
+    uint64_t total_ = 0;
+};
+
+// --- Leitura do Container ---
+
+/**
+ * @brief Arquivo de entrada mapeado somente-leitura na memória.
+ *
+ * Abrir é praticamente instantâneo mesmo para imagens de vários GB: as
+ * páginas só são lidas quando o scanner/descompressor tocam nelas, e o
+ * kernel é avisado de que a leitura é sequencial. Se o mapeamento falhar
+ * (ex: espaço de endereçamento do build Win32), cai para uma única leitura
+ * em bloco num buffer pré-alocado.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    // 'path' de std::string está na codificação nativa (no Windows, a página
+    // ANSI); um std::filesystem::path largo abre qualquer nome.
+    bool open(const std::filesystem::path& fsPath) {
+        close();
+#ifdef _WIN32
+        file_ = CreateFileW(fsPath.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER sz;
+        if (!GetFileSizeEx(file_, &sz)) return false;
+        if ((unsigned long long)sz.QuadPart > (unsigned long long)SIZE_MAX) return false;
+        size_ = (size_t)sz.QuadPart;
+        if (size_ == 0) return true;
+        mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping_) {
+            data_ = static_cast<const uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+        }
+        if (data_) return true;
+        return readAll();
+#else
+        fd_ = ::open(fsPath.c_str(), O_RDONLY);
+        if (fd_ < 0) return false;
+        struct stat st;
+        if (fstat(fd_, &st) != 0) return false;
+        if ((unsigned long long)st.st_size > (unsigned long long)SIZE_MAX) return false;
+        size_ = (size_t)st.st_size;
+        if (size_ == 0) return true;
+        void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (p != MAP_FAILED) {
+            data_ = static_cast<const uint8_t*>(p);
+            mapped_ = true;
+            madvise(p, size_, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+            madvise(p, size_, MADV_HUGEPAGE); // Só tem efeito se o kernel suportar THP para arquivos
+#endif
+            return true;
+        }
+        return readAll();
+#endif
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (data_ && owned_.empty()) UnmapViewOfFile(data_);
+        if (mapping_) CloseHandle(mapping_);
+        if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+        mapping_ = nullptr;
+        file_ = INVALID_HANDLE_VALUE;
+#else
+        if (mapped_) munmap(const_cast<uint8_t*>(data_), size_);
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+        mapped_ = false;
+#endif
+        owned_.clear();
+        owned_.shrink_to_fit();
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    ByteView view() const { return ByteView(data_, size_); }
+
+    // Pede ao SO para começar a ler o arquivo inteiro em segundo plano
+    // (o --batch chama no próximo container enquanto processa o atual).
+    void prefetch() const {
+        if (!data_ || !owned_.empty()) return;
+#ifdef _WIN32
+#if defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0602
+        WIN32_MEMORY_RANGE_ENTRY range;
+        range.VirtualAddress = const_cast<uint8_t*>(data_);
+        range.NumberOfBytes = size_;
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+#else
+        madvise(const_cast<uint8_t*>(data_), size_, MADV_WILLNEED);
+#endif
+    }
+
+private:
+    // Plano B: uma leitura em bloco para um buffer já do tamanho final
+    // (sem realocações nem pico de memória dobrado).
+    bool readAll() {
+        try {
+            owned_.resize(size_);
+        }
+        catch (const std::bad_alloc&) {
+            return false;
+        }
+        size_t done = 0;
+        while (done < size_) {
+#ifdef _WIN32
+            DWORD chunk = (DWORD)std::min<size_t>(size_ - done, 1u << 30);
+            DWORD got = 0;
+            if (!ReadFile(file_, owned_.data() + done, chunk, &got, nullptr) || got == 0) return false;
+#else
+            ssize_t got = ::read(fd_, owned_.data() + done, std::min<size_t>(size_ - done, 1u << 30));
+            if (got <= 0) return false;
+#endif
+            done += (size_t)got;
+        }
+        data_ = owned_.data();
+        return true;
+    }
+
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    std::vector<uint8_t> owned_;
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+#else
+    int fd_ = -1;
+    bool mapped_ = false;
+#endif
+};
+
+/**
+ * @brief Leitura posicional (pread/ReadFile) para o scan em janelas:
+ * não mapeia nada, então funciona com arquivos maiores que a RAM e que o
+ * espaço de endereçamento do build de 32 bits.
+ */
+class FileReader {
+public:
+    FileReader() = default;
+    FileReader(const FileReader&) = delete;
+    FileReader& operator=(const FileReader&) = delete;
+    ~FileReader() { close(); }
+
+    // 'writable' abre para leitura e escrita em posições aleatórias (--repack).
+    bool open(const std::string& path, bool writable = false) {
+        close();
+        std::filesystem::path fsPath(path);
+#ifdef _WIN32
+        file_ = CreateFileW(fsPath.wstring().c_str(), writable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ,
+            FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | (writable ? FILE_FLAG_RANDOM_ACCESS : FILE_FLAG_SEQUENTIAL_SCAN), nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER sz;
+        if (!GetFileSizeEx(file_, &sz)) return false;
+        size_ = (uint64_t)sz.QuadPart;
+#else
+        fd_ = ::open(fsPath.c_str(), writable ? O_RDWR : O_RDONLY);
+        if (fd_ < 0) return false;
+        struct stat st;
+        if (fstat(fd_, &st) != 0) return false;
+        size_ = (uint64_t)st.st_size;
+#ifdef POSIX_FADV_SEQUENTIAL
+        if (!writable) posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+#endif
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+        file_ = INVALID_HANDLE_VALUE;
+#else
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+#endif
+        size_ = 0;
+    }
+
+    uint64_t size() const { return size_; }
+
+    // Lê exatamente 'len' bytes a partir de 'offset'.
+    bool readAt(uint64_t offset, uint8_t* dst, size_t len) {
+        while (len > 0) {
+            size_t chunk = std::min<size_t>(len, 1u << 30);
+#ifdef _WIN32
+            OVERLAPPED ov = {};
+            ov.Offset = (DWORD)offset;
+            ov.OffsetHigh = (DWORD)(offset >> 32);
+            DWORD got = 0;
+            if (!ReadFile(file_, dst, (DWORD)chunk, &got, &ov) || got == 0) return false;
+#else
+            ssize_t got = pread(fd_, dst, chunk, (off_t)offset);
+            if (got <= 0) return false;
+#endif
+            offset += (uint64_t)got;
+            dst += got;
+            len -= (size_t)got;
+        }
+        return true;
+    }
+
+    // Grava exatamente 'len' bytes em 'offset' (só se aberto com 'writable').
+    // Gravar além do fim estende o arquivo.
+    bool writeAt(uint64_t offset, const uint8_t* src, size_t len) {
+        while (len > 0) {
+            size_t chunk = std::min<size_t>(len, 1u << 30);
+#ifdef _WIN32
+            OVERLAPPED ov = {};
+            ov.Offset = (DWORD)offset;
+            ov.OffsetHigh = (DWORD)(offset >> 32);
+            DWORD wrote = 0;
+            if (!WriteFile(file_, src, (DWORD)chunk, &wrote, &ov) || wrote == 0) return false;
+#else
+            ssize_t wrote = pwrite(fd_, src, chunk, (off_t)offset);
+            if (wrote < 0 && errno == EINTR) continue;
+            if (wrote <= 0) return false;
+#endif
+            offset += (uint64_t)wrote;
+            src += wrote;
+            len -= (size_t)wrote;
+            size_ = std::max(size_, offset);
+        }
+        return true;
+    }
+
+private:
+    uint64_t size_ = 0;
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+#else
+    int fd_ = -1;
+#endif
+};
+
+bool loadInputFile(const std::string& inPath, MappedFile& inputData);
+
+// Chamado para cada bloco final do scan, com os bytes comprimidos dele.
+using BlockCallback = std::function<void(const ScanResult&, ByteView)>;
+
+std::vector<ScanResult> scanContainerStreaming(FileReader& file, size_t windowSize, size_t maxBlock,
+    ProgressReporter* progress = nullptr, const BlockCallback& onBlock = nullptr);
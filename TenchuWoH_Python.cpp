@@ -0,0 +1,421 @@
+// Módulo Python 'tenchuwoh' sobre a API C (TenchuWoH_CApi.h).
+//
+// Entradas são lidas pelo buffer protocol (bytes, bytearray, memoryview,
+// mmap...) sem cópia: o container segura a exportação do buffer enquanto
+// estiver aberto. Blocos descomprimidos voltam como objetos Block, que
+// também exportam o buffer protocol (memoryview(b), bytes(b), numpy...).
+// Scan e descompressão rodam sem o GIL, então vários threads Python
+// descomprimem em paralelo.
+//
+//   import tenchuwoh
+//   with tenchuwoh.Container(open("c.bin", "rb").read()) as c:
+//       for i, (offset, packed, size) in enumerate(c.blocks()):
+//           data = c.decode(i)
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h> // T_LONGLONG / READONLY
+
+#include "TenchuWoH_CApi.h"
+
+// --- Erros ---
+
+static PyObject* setStatusError(int status) {
+    switch (status) {
+    case TWOH_ERR_OUT_OF_MEMORY:
+        return PyErr_NoMemory();
+    case TWOH_ERR_IO:
+        PyErr_SetString(PyExc_OSError, twoh_status_string(status));
+        return nullptr;
+    case TWOH_ERR_ARGUMENT:
+        PyErr_SetString(PyExc_IndexError, twoh_status_string(status));
+        return nullptr;
+    default:
+        PyErr_SetString(PyExc_ValueError, twoh_status_string(status));
+        return nullptr;
+    }
+}
+
+// OSError da abertura de um arquivo, com o código do sistema guardado
+// pela API C (errno nem sempre é setado no Windows).
+static void setOpenError(PyObject* filename) {
+    int code = twoh_last_os_error();
+#ifdef _WIN32
+    PyErr_SetExcFromWindowsErrWithFilenameObject(PyExc_OSError, code, filename);
+#else
+    errno = code;
+    PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, filename);
+#endif
+}
+
+// --- Block: saída descomprimida com buffer protocol ---
+
+struct BlockObject {
+    PyObject_HEAD
+    uint8_t* data;
+    Py_ssize_t size;
+    long long offset; // Offset no container (-1 para bloco avulso)
+};
+
+static void Block_dealloc(BlockObject* self) {
+    PyMem_RawFree(self->data);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static int Block_getbuffer(BlockObject* self, Py_buffer* view, int flags) {
+    return PyBuffer_FillInfo(view, (PyObject*)self, self->data, self->size, 0, flags);
+}
+
+static Py_ssize_t Block_length(BlockObject* self) {
+    return self->size;
+}
+
+static PyObject* Block_repr(BlockObject* self) {
+    return PyUnicode_FromFormat("<tenchuwoh.Block offset=%lld size=%zd>", self->offset, self->size);
+}
+
+static PyBufferProcs Block_as_buffer = {
+    (getbufferproc)Block_getbuffer,
+    nullptr,
+};
+
+static PySequenceMethods Block_as_sequence = {
+    (lenfunc)Block_length,
+};
+
+static PyMemberDef Block_members[] = {
+    { "offset", T_LONGLONG, offsetof(BlockObject, offset), READONLY, "Offset do bloco no container (-1 se avulso)." },
+    { nullptr },
+};
+
+static PyTypeObject BlockType = {
+    PyVarObject_HEAD_INIT(nullptr, 0)
+    "tenchuwoh.Block",
+};
+
+// Aloca um Block de 'size' bytes (ainda não preenchidos).
+static BlockObject* newBlock(size_t size, long long offset) {
+    BlockObject* block = PyObject_New(BlockObject, &BlockType);
+    if (!block) return nullptr;
+    block->data = (uint8_t*)PyMem_RawMalloc(size ? size : 1);
+    block->size = (Py_ssize_t)size;
+    block->offset = offset;
+    if (!block->data) {
+        Py_DECREF(block);
+        return (BlockObject*)PyErr_NoMemory();
+    }
+    return block;
+}
+
+// --- Container ---
+
+struct ContainerObject {
+    PyObject_HEAD
+    twoh_container* handle;
+    Py_buffer source;  // Buffer de entrada (source.obj == nullptr se veio de um caminho)
+    int busy;          // Chamadas rodando sem o GIL; close() recusa enquanto não zerar
+};
+
+static void releaseContainer(ContainerObject* self) {
+    if (self->handle) {
+        twoh_close(self->handle);
+        self->handle = nullptr;
+    }
+    if (self->source.obj) PyBuffer_Release(&self->source);
+}
+
+static void Container_dealloc(ContainerObject* self) {
+    releaseContainer(self);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static int Container_init(ContainerObject* self, PyObject* args, PyObject* kwds) {
+    static const char* kwlist[] = { "source", nullptr };
+    PyObject* source;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O:Container", (char**)kwlist, &source)) return -1;
+    if (self->busy) {
+        PyErr_SetString(PyExc_BufferError, "container em uso por outro thread");
+        return -1;
+    }
+    releaseContainer(self);
+
+    int status;
+    if (PyUnicode_Check(source) || PyObject_HasAttrString(source, "__fspath__")) {
+#ifdef _WIN32
+        // No Windows o caminho vai em UTF-16: pela página ANSI do
+        // twoh_open_file, nomes fora dela não abririam.
+        PyObject* path = nullptr;
+        if (!PyUnicode_FSDecoder(source, &path)) return -1;
+        wchar_t* wpath = PyUnicode_AsWideCharString(path, nullptr);
+        Py_DECREF(path);
+        if (!wpath) return -1;
+        Py_BEGIN_ALLOW_THREADS
+        status = twoh_open_file_w(wpath, &self->handle);
+        Py_END_ALLOW_THREADS
+        PyMem_Free(wpath);
+#else
+        PyObject* path = nullptr;
+        if (!PyUnicode_FSConverter(source, &path)) return -1;
+        Py_BEGIN_ALLOW_THREADS
+        status = twoh_open_file(PyBytes_AS_STRING(path), &self->handle);
+        Py_END_ALLOW_THREADS
+        Py_DECREF(path);
+#endif
+        if (status == TWOH_ERR_IO) {
+            setOpenError(source);
+            return -1;
+        }
+    }
+    else {
+        if (PyObject_GetBuffer(source, &self->source, PyBUF_SIMPLE) < 0) return -1;
+        Py_BEGIN_ALLOW_THREADS
+        status = twoh_open_memory(self->source.buf, (size_t)self->source.len, &self->handle);
+        Py_END_ALLOW_THREADS
+    }
+    if (status != TWOH_OK) {
+        releaseContainer(self);
+        setStatusError(status);
+        return -1;
+    }
+    return 0;
+}
+
+static bool checkOpen(ContainerObject* self) {
+    if (self->handle) return true;
+    PyErr_SetString(PyExc_ValueError, "container fechado");
+    return false;
+}
+
+// Converte um índice estilo Python (aceita negativos).
+static bool blockIndex(ContainerObject* self, Py_ssize_t index, size_t& out) {
+    Py_ssize_t count = (Py_ssize_t)twoh_block_count(self->handle);
+    if (index < 0) index += count;
+    if (index < 0 || index >= count) {
+        PyErr_SetString(PyExc_IndexError, "indice de bloco fora da lista");
+        return false;
+    }
+    out = (size_t)index;
+    return true;
+}
+
+static PyObject* infoTuple(const twoh_block_info& info) {
+    return Py_BuildValue("(KKK)", (unsigned long long)info.offset, (unsigned long long)info.compressed_size,
+        (unsigned long long)info.decompressed_size);
+}
+
+static Py_ssize_t Container_length(ContainerObject* self) {
+    return self->handle ? (Py_ssize_t)twoh_block_count(self->handle) : 0;
+}
+
+static PyObject* Container_info(ContainerObject* self, PyObject* arg) {
+    Py_ssize_t index = PyNumber_AsSsize_t(arg, PyExc_IndexError);
+    size_t i;
+    if ((index == -1 && PyErr_Occurred()) || !checkOpen(self) || !blockIndex(self, index, i)) return nullptr;
+    twoh_block_info info;
+    int status = twoh_block_info_at(self->handle, i, &info);
+    return status == TWOH_OK ? infoTuple(info) : setStatusError(status);
+}
+
+static PyObject* Container_blocks(ContainerObject* self, PyObject*) {
+    if (!checkOpen(self)) return nullptr;
+    size_t count = twoh_block_count(self->handle);
+    PyObject* list = PyList_New((Py_ssize_t)count);
+    if (!list) return nullptr;
+    for (size_t i = 0; i < count; i++) {
+        twoh_block_info info;
+        twoh_block_info_at(self->handle, i, &info);
+        PyObject* item = infoTuple(info);
+        if (!item) {
+            Py_DECREF(list);
+            return nullptr;
+        }
+        PyList_SET_ITEM(list, (Py_ssize_t)i, item);
+    }
+    return list;
+}
+
+static PyObject* Container_decode(ContainerObject* self, PyObject* arg) {
+    Py_ssize_t index = PyNumber_AsSsize_t(arg, PyExc_IndexError);
+    size_t i;
+    if ((index == -1 && PyErr_Occurred()) || !checkOpen(self) || !blockIndex(self, index, i)) return nullptr;
+    twoh_block_info info;
+    twoh_block_info_at(self->handle, i, &info);
+    BlockObject* block = newBlock((size_t)info.decompressed_size, (long long)info.offset);
+    if (!block) return nullptr;
+
+    int status;
+    size_t written = 0;
+    self->busy++;
+    Py_BEGIN_ALLOW_THREADS
+    status = twoh_decode_block(self->handle, i, block->data, (size_t)block->size, &written);
+    Py_END_ALLOW_THREADS
+    self->busy--;
+    if (status != TWOH_OK) {
+        Py_DECREF(block);
+        return setStatusError(status);
+    }
+    return (PyObject*)block;
+}
+
+static PyObject* Container_decode_into(ContainerObject* self, PyObject* args) {
+    Py_ssize_t index;
+    Py_buffer out;
+    size_t i;
+    if (!PyArg_ParseTuple(args, "nw*:decode_into", &index, &out)) return nullptr;
+    if (!checkOpen(self) || !blockIndex(self, index, i)) {
+        PyBuffer_Release(&out);
+        return nullptr;
+    }
+
+    int status;
+    size_t written = 0;
+    self->busy++;
+    Py_BEGIN_ALLOW_THREADS
+    status = twoh_decode_block(self->handle, i, out.buf, (size_t)out.len, &written);
+    Py_END_ALLOW_THREADS
+    self->busy--;
+    PyBuffer_Release(&out);
+    if (status == TWOH_ERR_BUFFER_TOO_SMALL) {
+        PyErr_Format(PyExc_ValueError, "buffer de saida pequeno demais: o bloco precisa de %zu bytes", written);
+        return nullptr;
+    }
+    if (status != TWOH_OK) return setStatusError(status);
+    return PyLong_FromSize_t(written);
+}
+
+static PyObject* Container_close(ContainerObject* self, PyObject*) {
+    if (self->busy) {
+        PyErr_SetString(PyExc_BufferError, "container em uso por outro thread");
+        return nullptr;
+    }
+    releaseContainer(self);
+    Py_RETURN_NONE;
+}
+
+static PyObject* Container_enter(ContainerObject* self, PyObject*) {
+    Py_INCREF(self);
+    return (PyObject*)self;
+}
+
+static PyObject* Container_exit(ContainerObject* self, PyObject*) {
+    return Container_close(self, nullptr);
+}
+
+static PyMethodDef Container_methods[] = {
+    { "info", (PyCFunction)Container_info, METH_O,
+        "info(i) -> (offset, tamanho_comprimido, tamanho_descomprimido)" },
+    { "blocks", (PyCFunction)Container_blocks, METH_NOARGS,
+        "blocks() -> lista de (offset, tamanho_comprimido, tamanho_descomprimido), em ordem de offset" },
+    { "decode", (PyCFunction)Container_decode, METH_O,
+        "decode(i) -> Block com o bloco i descomprimido (sem o GIL)" },
+    { "decode_into", (PyCFunction)Container_decode_into, METH_VARARGS,
+        "decode_into(i, buffer) -> bytes escritos; descomprime num buffer gravavel do chamador" },
+    { "close", (PyCFunction)Container_close, METH_NOARGS,
+        "close() -> libera o buffer de entrada (ou o arquivo mapeado)" },
+    { "__enter__", (PyCFunction)Container_enter, METH_NOARGS, nullptr },
+    { "__exit__", (PyCFunction)Container_exit, METH_VARARGS, nullptr },
+    { nullptr },
+};
+
+static PySequenceMethods Container_as_sequence = {
+    (lenfunc)Container_length,
+};
+
+static PyTypeObject ContainerType = {
+    PyVarObject_HEAD_INIT(nullptr, 0)
+    "tenchuwoh.Container",
+};
+
+// --- Funções do módulo (blocos avulsos) ---
+
+static PyObject* module_probe(PyObject*, PyObject* arg) {
+    Py_buffer in;
+    if (PyObject_GetBuffer(arg, &in, PyBUF_SIMPLE) < 0) return nullptr;
+    twoh_block_info info;
+    int status;
+    Py_BEGIN_ALLOW_THREADS
+    status = twoh_probe_block(in.buf, (size_t)in.len, &info);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&in);
+    if (status == TWOH_ERR_CORRUPT || status == TWOH_ERR_ARGUMENT) Py_RETURN_NONE;
+    if (status != TWOH_OK) return setStatusError(status);
+    return Py_BuildValue("(KK)", (unsigned long long)info.compressed_size, (unsigned long long)info.decompressed_size);
+}
+
+static PyObject* module_decode(PyObject*, PyObject* arg) {
+    Py_buffer in;
+    if (PyObject_GetBuffer(arg, &in, PyBUF_SIMPLE) < 0) return nullptr;
+    twoh_block_info info;
+    int status;
+    Py_BEGIN_ALLOW_THREADS
+    status = twoh_probe_block(in.buf, (size_t)in.len, &info);
+    Py_END_ALLOW_THREADS
+    if (status != TWOH_OK) {
+        PyBuffer_Release(&in);
+        return setStatusError(status);
+    }
+    BlockObject* block = newBlock((size_t)info.decompressed_size, -1);
+    if (!block) {
+        PyBuffer_Release(&in);
+        return nullptr;
+    }
+    size_t written = 0;
+    Py_BEGIN_ALLOW_THREADS
+    status = twoh_decode(in.buf, (size_t)in.len, block->data, (size_t)block->size, &written);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&in);
+    if (status != TWOH_OK) {
+        Py_DECREF(block);
+        return setStatusError(status);
+    }
+    return (PyObject*)block;
+}
+
+static PyMethodDef module_methods[] = {
+    { "probe", module_probe, METH_O,
+        "probe(data) -> (tamanho_comprimido, tamanho_descomprimido) do bloco no inicio de data, ou None" },
+    { "decode", module_decode, METH_O,
+        "decode(data) -> Block com o bloco LZSS do inicio de data descomprimido (sem o GIL)" },
+    { nullptr },
+};
+
+static PyModuleDef tenchuwohModule = {
+    PyModuleDef_HEAD_INIT,
+    "tenchuwoh",
+    "Scanner e descompressor LZSS dos containers de Tenchu: Wrath of Heaven.",
+    -1,
+    module_methods,
+};
+
+PyMODINIT_FUNC PyInit_tenchuwoh(void) {
+    BlockType.tp_basicsize = sizeof(BlockObject);
+    BlockType.tp_dealloc = (destructor)Block_dealloc;
+    BlockType.tp_repr = (reprfunc)Block_repr;
+    BlockType.tp_as_buffer = &Block_as_buffer;
+    BlockType.tp_as_sequence = &Block_as_sequence;
+    BlockType.tp_members = Block_members;
+    BlockType.tp_flags = Py_TPFLAGS_DEFAULT;
+    BlockType.tp_doc = "Bloco descomprimido. Exporta o buffer protocol (memoryview, bytes(), numpy).";
+
+    ContainerType.tp_basicsize = sizeof(ContainerObject);
+    ContainerType.tp_dealloc = (destructor)Container_dealloc;
+    ContainerType.tp_as_sequence = &Container_as_sequence;
+    ContainerType.tp_methods = Container_methods;
+    ContainerType.tp_init = (initproc)Container_init;
+    ContainerType.tp_new = PyType_GenericNew;
+    ContainerType.tp_flags = Py_TPFLAGS_DEFAULT;
+    ContainerType.tp_doc = "Container(origem): bytes-like (sem copia) ou caminho; o scan roda na abertura.";
+
+    if (PyType_Ready(&BlockType) < 0 || PyType_Ready(&ContainerType) < 0) return nullptr;
+    PyObject* m = PyModule_Create(&tenchuwohModule);
+    if (!m) return nullptr;
+    Py_INCREF(&BlockType);
+    Py_INCREF(&ContainerType);
+    if (PyModule_AddObject(m, "Block", (PyObject*)&BlockType) < 0
+        || PyModule_AddObject(m, "Container", (PyObject*)&ContainerType) < 0
+        || PyModule_AddIntConstant(m, "API_VERSION", (long)twoh_api_version()) < 0) {
+        Py_DECREF(m);
+        return nullptr;
+    }
+    return m;
+}